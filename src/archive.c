@@ -0,0 +1,222 @@
+/*! \file archive.c
+ *  \brief Reading data files out of the packed archive.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include "dataarchive.h"
+#include <libsuperderpy.h>
+#include <allegro5/allegro_memfile.h>
+#include <allegro5/allegro_ttf.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// data.pak comes from tools/packdata at build time and gets mapped once.
+// Files found in it are decoded straight from memory through memfiles;
+// anything missing from it (or everything, without the archive) is read
+// from the data directory as before.
+
+void* MapFile(const char *filename, size_t *size) {
+#ifndef _WIN32
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+	struct stat st;
+	void *data = NULL;
+	if (!fstat(fd, &st) && (st.st_size > 0)) {
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			data = NULL;
+		}
+		*size = st.st_size;
+	}
+	close(fd);
+	return data;
+#else
+	// no mmap here, so read it in one go
+	ALLEGRO_FILE *file = al_fopen(filename, "rb");
+	if (!file) {
+		return NULL;
+	}
+	void *data = NULL;
+	int64_t length = al_fsize(file);
+	if (length > 0) {
+		data = malloc(length);
+		if (al_fread(file, data, length) != (size_t)length) {
+			free(data);
+			data = NULL;
+		}
+		*size = length;
+	}
+	al_fclose(file);
+	return data;
+#endif
+}
+
+void UnmapFile(void *data, size_t size) {
+#ifndef _WIN32
+	munmap(data, size);
+#else
+	free(data);
+#endif
+}
+
+static bool IsArchiveValid(void *file, size_t size) {
+	const struct DataArchiveHeader *header = file;
+	if ((size < sizeof(struct DataArchiveHeader)) || memcmp(header->magic, DATA_ARCHIVE_MAGIC, 4) ||
+	    (header->version != DATA_ARCHIVE_VERSION) ||
+	    (size < sizeof(struct DataArchiveHeader) + header->count * sizeof(struct DataArchiveEntry))) {
+		return false;
+	}
+	const struct DataArchiveEntry *entries = (const struct DataArchiveEntry*)(header + 1);
+	uint32_t i;
+	for (i = 0; i < header->count; i++) {
+		if ((entries[i].offset > size) || (entries[i].size > size - entries[i].offset)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void OpenDataArchive(struct Game *game, struct CommonResources *data) {
+#ifdef DRSAUCE_DATA_ARCHIVE
+	if (!atoi(GetConfigOptionDefault(game, "DrSauce", "data_archive", "1"))) {
+		return;
+	}
+	size_t size = 0;
+	void *file = MapFile(ResolveDataPath(game, "data.pak"), &size);
+	if (!file) {
+		PrintConsole(game, "Could not open the data archive, reading loose files");
+		return;
+	}
+	if (!IsArchiveValid(file, size)) {
+		PrintConsole(game, "Data archive is invalid, reading loose files");
+		UnmapFile(file, size);
+		return;
+	}
+	const struct DataArchiveHeader *header = file;
+	data->archive.file = file;
+	data->archive.size = size;
+	data->archive.entries = (const struct DataArchiveEntry*)(header + 1);
+	data->archive.count = header->count;
+	PrintConsole(game, "Data archive: %d files, %zu kB", data->archive.count, size / 1024);
+#endif
+}
+
+void CloseDataArchive(struct Game *game) {
+	// Whatever was opened from it (fonts, streams) has to be gone by now.
+	if (game->data->archive.file) {
+		UnmapFile(game->data->archive.file, game->data->archive.size);
+	}
+	game->data->archive.file = NULL;
+	game->data->archive.entries = NULL;
+	game->data->archive.count = 0;
+}
+
+static int CompareEntry(const void *k, const void *e) {
+	const struct DataArchiveEntry *entry = e;
+	return strncmp(k, entry->path, DATA_ARCHIVE_PATH);
+}
+
+const void* GetArchivedFile(struct Game *game, const char *filename, size_t *size) {
+	// Contents of the file within the mapping, or NULL when it's not archived.
+	// Doesn't touch any shared state, so it's fine to call from any thread.
+	if (!game->data || !game->data->archive.entries) {
+		return NULL;
+	}
+	const struct DataArchiveEntry *entry = bsearch(filename, game->data->archive.entries, game->data->archive.count,
+	                                               sizeof(struct DataArchiveEntry), CompareEntry);
+	if (!entry) {
+		return NULL;
+	}
+	*size = entry->size;
+	return (const char*)game->data->archive.file + entry->offset;
+}
+
+ALLEGRO_FILE* OpenMemoryFile(const void *contents, size_t size) {
+	// the archive is mapped read only, and memfiles opened with "r" never write
+	return al_open_memfile((void*)contents, size, "r");
+}
+
+ALLEGRO_FILE* OpenDataFile(struct Game *game, const char *filename) {
+	size_t size;
+	const void *contents = GetArchivedFile(game, filename, &size);
+	if (contents) {
+		return OpenMemoryFile(contents, size);
+	}
+	return al_fopen(ResolveDataPath(game, filename), "rb");
+}
+
+const char* GetFileExtension(const char *filename) {
+	// what Allegro's *_f loaders use to pick a decoder
+	const char *extension = strrchr(filename, '.');
+	return extension ? extension : "";
+}
+
+ALLEGRO_BITMAP* LoadDataBitmap(struct Game *game, const char *filename) {
+	size_t size;
+	const void *contents = GetArchivedFile(game, filename, &size);
+	if (contents) {
+		return DecodeBitmap(game, filename, contents, size);
+	}
+	return DecodeBitmapFile(game, ResolveDataPath(game, filename));
+}
+
+ALLEGRO_SAMPLE* LoadDataSample(struct Game *game, const char *filename) {
+	// to be destroyed with DestroySample
+	size_t size;
+	const void *contents = GetArchivedFile(game, filename, &size);
+	if (contents) {
+		return DecodeSample(game, filename, contents, size);
+	}
+	return DecodeSampleFile(game, ResolveDataPath(game, filename));
+}
+
+ALLEGRO_AUDIO_STREAM* LoadDataAudioStream(struct Game *game, const char *filename, size_t buffers, unsigned int samples) {
+	// the stream keeps reading from the file, and closes it when destroyed
+	ALLEGRO_FILE *file = OpenDataFile(game, filename);
+	if (!file) {
+		return NULL;
+	}
+	return al_load_audio_stream_f(file, GetFileExtension(filename), buffers, samples);
+}
+
+ALLEGRO_FONT* LoadDataTTF(struct Game *game, const char *filename, int size, int flags) {
+	// glyphs are rasterized from the file as they're needed, so the font owns it
+	ALLEGRO_FILE *file = OpenDataFile(game, filename);
+	if (!file) {
+		return NULL;
+	}
+	return al_load_ttf_font_f(file, filename, size, flags);
+}
+
+ALLEGRO_CONFIG* LoadDataConfig(struct Game *game, const char *filename) {
+	ALLEGRO_FILE *file = OpenDataFile(game, filename);
+	if (!file) {
+		return NULL;
+	}
+	ALLEGRO_CONFIG *config = al_load_config_file_f(file);
+	al_fclose(file);
+	return config;
+}
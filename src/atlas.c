@@ -0,0 +1,112 @@
+/*! \file atlas.c
+ *  \brief Spritesheets served from prepacked texture atlases.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+// Atlas pages and sprites/atlas.ini come from tools/packsprites at build
+// time. Every spritesheet found there becomes a sub-bitmap of its page, so
+// characters sharing a page draw without switching textures.
+
+void LoadSpriteAtlas(struct Game *game, struct CommonResources *data) {
+#ifdef DRSAUCE_SPRITE_ATLAS
+	ALLEGRO_CONFIG *config = LoadDataConfig(game, "sprites/atlas.ini");
+	if (!config) {
+		PrintConsole(game, "Could not load the sprite atlas, loading spritesheets separately");
+		return;
+	}
+	const char *value = al_get_config_value(config, "", "pages");
+	int pages = value ? atoi(value) : 0, i;
+	data->atlas.pages = calloc(pages, sizeof(ALLEGRO_BITMAP*));
+	data->atlas.page_count = pages;
+	for (i = 0; i < pages; i++) {
+		char filename[255];
+		snprintf(filename, 255, "sprites/atlas-%d.png", i);
+		data->atlas.pages[i] = AcquireBitmap(game, filename);
+	}
+
+	ALLEGRO_CONFIG_SECTION *iterator;
+	const char *section = al_get_first_config_section(config, &iterator);
+	while (section) {
+		const char *separator = strchr(section, '/');
+		const char *page = al_get_config_value(config, section, "page");
+		const char *rect = al_get_config_value(config, section, "rect");
+		struct AtlasEntry entry;
+		if (separator && page && rect &&
+		    (sscanf(rect, "%d %d %d %d", &entry.x, &entry.y, &entry.w, &entry.h) == 4)) {
+			entry.page = atoi(page);
+			if ((entry.page >= 0) && (entry.page < pages) && data->atlas.pages[entry.page]) {
+				entry.character = strndup(section, separator - section);
+				entry.spritesheet = strdup(separator + 1);
+				data->atlas.entries = realloc(data->atlas.entries, sizeof(struct AtlasEntry) * (data->atlas.count + 1));
+				data->atlas.entries[data->atlas.count++] = entry;
+			}
+		}
+		section = al_get_next_config_section(&iterator);
+	}
+	al_destroy_config(config);
+	PrintConsole(game, "Sprite atlas: %d spritesheets on %d page(s)", data->atlas.count, pages);
+#endif
+}
+
+void DestroySpriteAtlas(struct Game *game) {
+	// Characters' sub-bitmaps have to be gone by now.
+	int i;
+	for (i = 0; i < game->data->atlas.count; i++) {
+		free(game->data->atlas.entries[i].character);
+		free(game->data->atlas.entries[i].spritesheet);
+	}
+	free(game->data->atlas.entries);
+	for (i = 0; i < game->data->atlas.page_count; i++) {
+		ReleaseResource(game, game->data->atlas.pages[i]);
+	}
+	free(game->data->atlas.pages);
+	memset(&game->data->atlas, 0, sizeof(game->data->atlas));
+}
+
+static struct AtlasEntry* FindAtlasEntry(struct Game *game, const char *character, const char *spritesheet) {
+	int i;
+	for (i = 0; i < game->data->atlas.count; i++) {
+		if (!strcmp(game->data->atlas.entries[i].spritesheet, spritesheet) &&
+		    !strcmp(game->data->atlas.entries[i].character, character)) {
+			return &game->data->atlas.entries[i];
+		}
+	}
+	return NULL;
+}
+
+void LoadCharacterSpritesheets(struct Game *game, struct Character *character) {
+	// Drop-in replacement for LoadSpritesheets. A character is served from the
+	// atlas only when all of its registered spritesheets are in there;
+	// otherwise it's loaded the usual way, one file per sheet.
+	struct Spritesheet *tmp = character->spritesheets;
+	while (tmp) {
+		if (!FindAtlasEntry(game, character->name, tmp->name)) {
+			LoadSpritesheets(game, character);
+			return;
+		}
+		tmp = tmp->next;
+	}
+	for (tmp = character->spritesheets; tmp; tmp = tmp->next) {
+		struct AtlasEntry *entry = FindAtlasEntry(game, character->name, tmp->name);
+		tmp->bitmap = al_create_sub_bitmap(game->data->atlas.pages[entry->page], entry->x, entry->y, entry->w, entry->h);
+	}
+}
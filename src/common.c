@@ -22,58 +22,220 @@
 #include "common.h"
 #include <libsuperderpy.h>
 
-struct CommonResources* CreateGameData(struct Game *game) {
-	struct CommonResources* data = calloc(1, sizeof(struct CommonResources));
-
+static void CreatePanels(struct CommonResources *data) {
+	// All four panels live in a single 1280x180 strip texture, each one being
+	// a sub-bitmap rendered directly into its own slot.
 	int flags = al_get_new_bitmap_flags();
 	al_add_new_bitmap_flag(ALLEGRO_NO_PRESERVE_TEXTURE);
-	data->atari = al_create_bitmap(320, 180);
-	data->pegasus = al_create_bitmap(320, 180);
-	data->tape = al_create_bitmap(320, 180);
-	data->floppy = al_create_bitmap(320, 180);
+	data->strip = al_create_bitmap(320*4, 180);
+	al_set_new_bitmap_flags(flags);
+	data->atari = al_create_sub_bitmap(data->strip, 0, 0, 320, 180);
+	data->pegasus = al_create_sub_bitmap(data->strip, 320, 0, 320, 180);
+	data->tape = al_create_sub_bitmap(data->strip, 320*2, 0, 320, 180);
+	data->floppy = al_create_sub_bitmap(data->strip, 320*3, 0, 320, 180);
+}
+
+static void DestroyPanels(struct CommonResources *data) {
+	al_destroy_bitmap(data->atari);
+	al_destroy_bitmap(data->pegasus);
+	al_destroy_bitmap(data->tape);
+	al_destroy_bitmap(data->floppy);
+	al_destroy_bitmap(data->strip);
+}
+
+static void CreateFrame(struct Game *game, struct CommonResources *data) {
+	// Everything gets rendered at the authored resolution first and upscaled
+	// once; no filtering so the integer scale keeps pixels sharp.
+	int flags = al_get_new_bitmap_flags();
+	al_set_new_bitmap_flags((flags | ALLEGRO_NO_PRESERVE_TEXTURE) & ~(ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR));
+	data->frame = al_create_bitmap(game->viewport.width, game->viewport.height);
 	al_set_new_bitmap_flags(flags);
+}
+
+static void GetFrameLayout(struct Game *game, float *scale, int *x, int *y) {
+	int w = al_get_display_width(game->display), h = al_get_display_height(game->display);
+	int s = w / game->viewport.width;
+	if (h / game->viewport.height < s) {
+		s = h / game->viewport.height;
+	}
+	*scale = s;
+	if (s < 1) {
+		// Display smaller than the viewport; shrink rather than crop.
+		*scale = w / (float)game->viewport.width;
+		if (h / (float)game->viewport.height < *scale) {
+			*scale = h / (float)game->viewport.height;
+		}
+	}
+	*x = (w - game->viewport.width * *scale) / 2;
+	*y = (h - game->viewport.height * *scale) / 2;
+}
+
+static void CreateHardwareCursor(struct Game *game, struct CommonResources *data) {
+	// The OS draws the cursor at the display resolution, so scale it up
+	// the same way the viewport is.
+	int scale = al_get_display_width(game->display) / game->viewport.width;
+	if (al_get_display_height(game->display) / game->viewport.height < scale) {
+		scale = al_get_display_height(game->display) / game->viewport.height;
+	}
+	if (scale < 1) {
+		scale = 1;
+	}
+	int w = al_get_bitmap_width(data->cursor.bitmap), h = al_get_bitmap_height(data->cursor.bitmap);
+	ALLEGRO_BITMAP *bitmap = al_create_bitmap(w * scale, h * scale);
+	ALLEGRO_BITMAP *target = al_get_target_bitmap();
+	al_set_target_bitmap(bitmap);
+	al_clear_to_color(al_map_rgba(0,0,0,0));
+	al_draw_scaled_bitmap(data->cursor.bitmap, 0, 0, w, h, 0, 0, w * scale, h * scale, 0);
+	al_set_target_bitmap(target);
+
+	if (data->cursor.hardware) {
+		al_destroy_mouse_cursor(data->cursor.hardware);
+	}
+	data->cursor.hardware = al_create_mouse_cursor(bitmap, 0, 0);
+	al_destroy_bitmap(bitmap);
+	if (data->cursor.hardware) {
+		al_set_mouse_cursor(game->display, data->cursor.hardware);
+	} else {
+		PrintConsole(game, "Hardware cursor unavailable, drawing it in software");
+	}
+	if (!data->cursor.shown) {
+		al_hide_mouse_cursor(game->display);
+	}
+}
+
+struct CommonResources* CreateGameData(struct Game *game) {
+	struct CommonResources* data = calloc(1, sizeof(struct CommonResources));
+
+	CreatePanels(data);
+	game->data = data; // the resource cache lives in here
+	IndexDataPaths(game, data);
+	OpenDataArchive(game, data);
+	OpenTextureCache(game, data);
+	OpenSampleCache(game, data);
+	InitVoices(game, data);
+	data->bg = AcquireBitmap(game, "stage.png");
 
 	data->offset = 0;
+	LoadSpriteTrims(game, data);
+	LoadSpriteAtlas(game, data);
+	LoadSpriteManifest(game, data);
+	data->culling = atoi(GetConfigOptionDefault(game, "DrSauce", "culling", "1"));
+	if (atoi(GetConfigOptionDefault(game, "DrSauce", "native", "1"))) {
+		CreateFrame(game, data);
+	}
 
 	data->text = NULL;
 	data->doctor = false;
 
-	data->sample = al_load_sample(GetDataFilePath(game, "warning.flac"));
-	data->sample_instance = al_create_sample_instance(data->sample);
-	al_attach_sample_instance_to_mixer(data->sample_instance, game->audio.fx);
+	data->cursor.bitmap = AcquireBitmap(game, "sprites/cursor/pointer.png");
+	if (atoi(GetConfigOptionDefault(game, "DrSauce", "hardware_cursor", "1"))) {
+		CreateHardwareCursor(game, data);
+	}
+
+	InitFx(game, data);
+	// several machines can fail close together; let them overlap a bit
+	data->warning = (struct FxSound){.sample = AcquireSample(game, "warning.flac"), .polyphony = 2, .priority = FX_PRIORITY_NORMAL};
 
 	data->charge = 0;
 
+	data->batch.slot = -1;
+
+	data->overdraw.enabled = atoi(GetConfigOptionDefault(game, "DrSauce", "overdraw", "0"));
+
+	data->idle.enabled = atoi(GetConfigOptionDefault(game, "DrSauce", "idle_skipping", "1"));
+	data->idle.background_fps = atoi(GetConfigOptionDefault(game, "DrSauce", "background_fps", "10"));
+	data->idle.redraw = true;
+	data->idle.compose = true;
+	data->idle.focused = true;
+
 	return data;
 }
 
 bool GlobalEventHandler(struct Game *game, ALLEGRO_EVENT *event) {
+	DispatchVoiceEvents(game);
 	if (event->type == ALLEGRO_EVENT_DISPLAY_RESUME_DRAWING) {
-		int flags = al_get_new_bitmap_flags();
-		al_add_new_bitmap_flag(ALLEGRO_NO_PRESERVE_TEXTURE);
-		game->data->atari = al_create_bitmap(320, 180);
-		game->data->pegasus = al_create_bitmap(320, 180);
-		game->data->tape = al_create_bitmap(320, 180);
-		game->data->floppy = al_create_bitmap(320, 180);
-		al_set_new_bitmap_flags(flags);
+		DestroyPanels(game->data);
+		CreatePanels(game->data);
+		InvalidatePanels(game);
+		InvalidateTextCache(game, NULL);
+		if (game->data->frame) {
+			al_destroy_bitmap(game->data->frame);
+			CreateFrame(game, game->data);
+		}
+	}
+	switch (event->type) {
+		case ALLEGRO_EVENT_DISPLAY_SWITCH_OUT:
+			game->data->idle.focused = false;
+			break;
+		case ALLEGRO_EVENT_DISPLAY_SWITCH_IN:
+			game->data->idle.focused = true;
+			// fall through
+		case ALLEGRO_EVENT_DISPLAY_RESUME_DRAWING:
+		case ALLEGRO_EVENT_DISPLAY_EXPOSE:
+		case ALLEGRO_EVENT_DISPLAY_RESIZE:
+		case ALLEGRO_EVENT_KEY_DOWN:
+		case ALLEGRO_EVENT_KEY_UP:
+		case ALLEGRO_EVENT_MOUSE_AXES:
+		case ALLEGRO_EVENT_MOUSE_BUTTON_DOWN:
+		case ALLEGRO_EVENT_MOUSE_BUTTON_UP:
+		case ALLEGRO_EVENT_TOUCH_BEGIN:
+		case ALLEGRO_EVENT_TOUCH_MOVE:
+		case ALLEGRO_EVENT_TOUCH_END:
+			RequestRedraw(game);
+			break;
+	}
+	if ((event->type == ALLEGRO_EVENT_DISPLAY_RESIZE) && (game->data->cursor.hardware)) {
+		CreateHardwareCursor(game, game->data);
+	}
+	if (game->config.debug && (event->type == ALLEGRO_EVENT_KEY_DOWN) && (event->keyboard.keycode == ALLEGRO_KEY_F9)) {
+		game->data->overdraw.enabled = !game->data->overdraw.enabled;
+		// cached panels haven't recorded what they filled
+		InvalidatePanels(game);
+	}
+	if (game->config.debug && (event->type == ALLEGRO_EVENT_KEY_DOWN) && (event->keyboard.keycode == ALLEGRO_KEY_F10)) {
+		ReportResources(game);
 	}
 	return false;
 }
 
 
 void DestroyGameData(struct Game *game, struct CommonResources *resources) {
-	al_destroy_bitmap(game->data->atari);
-	al_destroy_bitmap(game->data->pegasus);
-	al_destroy_bitmap(game->data->tape);
-	al_destroy_bitmap(game->data->floppy);
-	al_destroy_sample_instance(game->data->sample_instance);
-	al_destroy_sample(game->data->sample);
+	DestroyPanels(game->data);
+	InvalidateTextCache(game, NULL);
+	DestroySpriteTrims(game);
+	DestroySpriteAtlas(game);
+	DestroySpriteManifest(game);
+	ReleaseResource(game, game->data->bg);
+	if (game->data->frame) {
+		al_destroy_bitmap(game->data->frame);
+	}
+	if (game->data->cursor.hardware) {
+		al_destroy_mouse_cursor(game->data->cursor.hardware);
+	}
+	ReleaseResource(game, game->data->cursor.bitmap);
+	int i;
+	for (i = 0; i < 4; i++) {
+		free(game->data->panels[i].state);
+	}
+	DestroyFx(game);
+	ReleaseResource(game, game->data->warning.sample);
+	StopMusic(game);
+	DestroyVoices(game);
+	DestroyAssetQueue(game);
+	DestroyResources(game);
+	CloseDataArchive(game);
+	CloseTextureCache(game);
+	CloseSampleCache(game);
+	DestroyDataPaths(game);
 	free(resources);
 }
 
 void StartGame(struct Game *game) {
 	UnloadAllGamestates(game);
 
+	// Gamestates are drawn in the order they're loaded, so all of them are loaded
+	// here. Only intro and hud load their assets up front though; the machines
+	// queue theirs to be decoded in the background while the intro plays.
 	LoadGamestate(game, "intro");
 	LoadGamestate(game, "atari");
 	LoadGamestate(game, "pegasus");
@@ -106,7 +268,324 @@ void UpdateStatus(struct Game *game) {
 
 	if (!game->data->status.atari || !game->data->status.floppy || !game->data->status.pegasus || !game->data->status.tape) {
 		if (!game->data->won) {
-			al_play_sample_instance(game->data->sample_instance);
+			PlayFx(game, &game->data->warning);
+		}
+	}
+}
+
+bool IsScreenVisible(struct Game *game, int screen) {
+	// At most two 320px screens intersect the viewport: the one at offset and,
+	// unless we're exactly aligned, the one after it (wrapping around the strip).
+	if (!game->data->culling) {
+		return true;
+	}
+	int first = game->data->offset / 320;
+	if (screen == first) {
+		return true;
+	}
+	return (game->data->offset % 320) && (screen == (first + 1) % 4);
+}
+
+int GetScreenX(struct Game *game, int screen) {
+	// Where the screen's slot of the strip lands on the viewport.
+	int x = screen*320 - game->data->offset;
+	if (x <= -320) {
+		x += 4*320;
+	}
+	return x;
+}
+
+static void RecordFill(struct Game *game, int slot, float x, float y, float w, float h) {
+	if (!game->data->overdraw.enabled || (game->data->overdraw.count[slot] >= OVERDRAW_RECTS)) {
+		return;
+	}
+	float *rect = game->data->overdraw.rects[slot][game->data->overdraw.count[slot]++];
+	rect[0] = x;
+	rect[1] = y;
+	rect[2] = w;
+	rect[3] = h;
+}
+
+static void DrawOverdraw(struct Game *game) {
+	// Replaces the composed frame with a heatmap of how many times each pixel
+	// got filled: by the panel renders, the strip blit and the HUD on top.
+	ALLEGRO_COLOR heat = al_map_rgb(48, 16, 4);
+	int op, src, dst;
+	al_get_blender(&op, &src, &dst);
+	al_clear_to_color(al_map_rgb(0,0,0));
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ONE);
+	int i, j;
+	for (i = 0; i < 4; i++) {
+		if (!IsScreenVisible(game, i)) {
+			continue;
+		}
+		int x = GetScreenX(game, i);
+		al_draw_filled_rectangle(x, 0, x + 320, 180, heat);
+		for (j = 0; j < game->data->overdraw.count[i]; j++) {
+			float *rect = game->data->overdraw.rects[i][j];
+			al_draw_filled_rectangle(x + rect[0], rect[1], x + rect[0] + rect[2], rect[1] + rect[3], heat);
+		}
+	}
+	for (j = 0; j < game->data->overdraw.count[STATS_SLOT_HUD]; j++) {
+		float *rect = game->data->overdraw.rects[STATS_SLOT_HUD][j];
+		al_draw_filled_rectangle(rect[0], rect[1], rect[0] + rect[2], rect[1] + rect[3], heat);
+	}
+	al_set_blender(op, src, dst);
+}
+
+void GetCharacterState(struct Character *character, struct CharacterState *state) {
+	state->spritesheet = character->spritesheet;
+	state->pos = character->pos;
+	state->x = character->x;
+	state->y = character->y;
+	state->angle = character->angle;
+}
+
+static bool IsCompositionThrottled(struct Game *game, double now) {
+	// Out of focus, changes are composed at most background_fps times a
+	// second. They stay pending in the meantime; logic and events go on.
+	return game->data->frame && !game->data->idle.focused && (game->data->idle.background_fps > 0) &&
+	       (now < game->data->idle.last_compose + 1.0 / game->data->idle.background_fps);
+}
+
+bool BeginPanelDraw(struct Game *game, int screen, ALLEGRO_BITMAP *panel, const void *state, size_t size) {
+	// Returns false when the panel's texture can be reused as-is, either because
+	// it's not visible at all or because nothing it depends on has changed since
+	// the last time it was rendered. Otherwise the panel becomes the target.
+	// Changes that come in while composition is throttled aren't rendered
+	// either; the cached state is left alone, so they're picked up later.
+	struct PanelCache *cache = &game->data->panels[screen];
+	if (!IsScreenVisible(game, screen) ||
+	    (cache->valid && (cache->size == size) && !memcmp(cache->state, state, size)) ||
+	    IsCompositionThrottled(game, al_get_time())) {
+		game->data->stats.pending.skipped_panels++;
+		return false;
+	}
+	if (cache->size != size) {
+		free(cache->state);
+		cache->state = malloc(size);
+		cache->size = size;
+	}
+	memcpy(cache->state, state, size);
+	cache->valid = true;
+	RequestRedraw(game);
+	game->data->overdraw.count[screen] = 0;
+	RecordFill(game, screen, 0, 0, 320, 180);
+
+	// Panels are drawn straight over their part of the stage background,
+	// so restore it first instead of clearing the slot.
+	al_set_target_bitmap(panel);
+	int op, src, dst;
+	al_get_blender(&op, &src, &dst);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+	al_draw_bitmap_region(game->data->bg, screen*320, 0, 320, 180, 0, 0, 0);
+	al_set_blender(op, src, dst);
+	return true;
+}
+
+void InvalidatePanels(struct Game *game) {
+	int i;
+	for (i = 0; i < 4; i++) {
+		game->data->panels[i].valid = false;
+	}
+}
+
+void RequestRedraw(struct Game *game) {
+	game->data->idle.redraw = true;
+}
+
+bool BeginComposition(struct Game *game) {
+	// Called by the stage before composing the panels onto the frame. Returns
+	// false when nothing visible changed since the last composed frame (no panel
+	// got re-rendered this frame, no scrolling, no HUD change and no input),
+	// in which case the frame kept from last time gets presented as it is.
+	// That needs the native resolution frame, as the backbuffer doesn't keep
+	// its contents across flips.
+	if (game->data->frame && game->data->idle.enabled && !game->config.debug && !game->data->overdraw.enabled &&
+	    !game->data->idle.redraw && (game->data->offset == game->data->idle.offset)) {
+		game->data->idle.compose = false;
+		return false;
+	}
+	double now = al_get_time();
+	if (IsCompositionThrottled(game, now)) {
+		game->data->idle.compose = false;
+		return false;
+	}
+	game->data->idle.last_compose = now;
+	game->data->idle.offset = game->data->offset;
+	game->data->idle.redraw = false;
+	game->data->idle.compose = true;
+	return true;
+}
+
+void FinishFrameStats(struct Game *game) {
+	game->data->stats.last = game->data->stats.pending;
+	memset(&game->data->stats.pending, 0, sizeof(struct FrameStats));
+}
+
+bool IsCursorVisible(struct Game *game) {
+	if (!game->data->mouse_visible) {
+		return false;
+	}
+	int x = (game->data->offset + game->data->mousex) % (4*320);
+	if (x < 0) {
+		x += 4*320;
+	}
+	return game->data->cursor.enabled[x / 320];
+}
+
+void DrawCursor(struct Game *game) {
+	// Called once per frame after everything else has been composed onto the backbuffer.
+	bool visible = IsCursorVisible(game);
+	if (game->data->cursor.hardware) {
+		if (visible != game->data->cursor.shown) {
+			if (visible) {
+				al_show_mouse_cursor(game->display);
+			} else {
+				al_hide_mouse_cursor(game->display);
+			}
+		}
+	} else if (visible) {
+		al_draw_bitmap(game->data->cursor.bitmap, game->data->mousex, game->data->mousey, 0);
+	}
+	game->data->cursor.shown = visible;
+}
+
+void SetFrameTarget(struct Game *game) {
+	if (game->data->frame) {
+		al_set_target_bitmap(game->data->frame);
+	} else {
+		al_set_target_backbuffer(game->display);
+	}
+}
+
+void PresentFrame(struct Game *game) {
+	// Called by whichever gamestate draws last, once the whole viewport is composed.
+	if (game->data->overdraw.enabled) {
+		DrawOverdraw(game);
+		game->data->overdraw.count[STATS_SLOT_HUD] = 0;
+	}
+	if (game->data->frame) {
+		float scale;
+		int x, y;
+		GetFrameLayout(game, &scale, &x, &y);
+
+		al_set_target_backbuffer(game->display);
+		ALLEGRO_TRANSFORM transform, old;
+		al_copy_transform(&old, al_get_current_transform());
+		int cx, cy, cw, ch;
+		al_get_clipping_rectangle(&cx, &cy, &cw, &ch);
+
+		al_identity_transform(&transform);
+		al_use_transform(&transform);
+		al_reset_clipping_rectangle();
+		al_clear_to_color(al_map_rgb(0,0,0));
+		al_draw_scaled_bitmap(game->data->frame, 0, 0, game->viewport.width, game->viewport.height,
+		                      x, y, game->viewport.width * scale, game->viewport.height * scale, 0);
+
+		al_scale_transform(&transform, scale, scale);
+		al_translate_transform(&transform, x, y);
+		al_use_transform(&transform);
+		DrawCursor(game);
+
+		al_use_transform(&old);
+		al_set_clipping_rectangle(cx, cy, cw, ch);
+	} else {
+		DrawCursor(game);
+	}
+	FinishFrameStats(game);
+	game->data->idle.compose = true;
+}
+
+void WindowToViewport(struct Game *game, int x, int y, int *vx, int *vy) {
+	if (game->data->frame) {
+		float scale;
+		int ox, oy;
+		GetFrameLayout(game, &scale, &ox, &oy);
+		*vx = (x - ox) / scale;
+		*vy = (y - oy) / scale;
+	} else {
+		*vx = (x / (float)al_get_display_width(game->display)) * game->viewport.width;
+		*vy = (y / (float)al_get_display_height(game->display)) * game->viewport.height;
+	}
+	if (*vx < 0) {
+		*vx = 0;
+	}
+	if (*vx >= game->viewport.width) {
+		*vx = game->viewport.width - 1;
+	}
+	if (*vy < 0) {
+		*vy = 0;
+	}
+	if (*vy >= game->viewport.height) {
+		*vy = game->viewport.height - 1;
+	}
+}
+
+void BeginBatch(struct Game *game, int slot) {
+	// Consecutive draws sampling the same texture get submitted together
+	// until the batch is flushed or ended.
+	game->data->batch.slot = slot;
+	game->data->batch.texture = NULL;
+	al_hold_bitmap_drawing(true);
+}
+
+void FlushBatch(struct Game *game) {
+	// Needed before anything that doesn't go through held drawing, like primitives.
+	al_hold_bitmap_drawing(false);
+	al_hold_bitmap_drawing(true);
+	game->data->batch.texture = NULL;
+}
+
+void EndBatch(struct Game *game) {
+	al_hold_bitmap_drawing(false);
+	game->data->batch.slot = -1;
+}
+
+static void CountDraw(struct Game *game, const void *texture, float x, float y, float w, float h) {
+	int slot = game->data->batch.slot;
+	if (slot < 0) {
+		return;
+	}
+	RecordFill(game, slot, x, y, w, h);
+	game->data->stats.pending.draws[slot]++;
+	if (texture != game->data->batch.texture) {
+		game->data->stats.pending.batches[slot]++;
+		game->data->batch.texture = texture;
+	}
+}
+
+static const void* GetTexture(ALLEGRO_BITMAP *bitmap) {
+	ALLEGRO_BITMAP *parent = al_get_parent_bitmap(bitmap);
+	return parent ? parent : bitmap;
+}
+
+void DrawBatchedBitmap(struct Game *game, ALLEGRO_BITMAP *bitmap, float x, float y, int flags) {
+	CountDraw(game, GetTexture(bitmap), x, y, al_get_bitmap_width(bitmap), al_get_bitmap_height(bitmap));
+	al_draw_bitmap(bitmap, x, y, flags);
+}
+
+void DrawBatchedCharacter(struct Game *game, struct Character *character, ALLEGRO_COLOR tint, int flags) {
+	// Only the part of the frame that has any opaque pixels gets drawn, if known.
+	ALLEGRO_BITMAP *bitmap = character->spritesheet->bitmap;
+	float x, y;
+	int sx, sy, w, h;
+	if (GetCharacterTrim(game, character, flags, &x, &y, &sx, &sy, &w, &h)) {
+		if (w && h) {
+			CountDraw(game, GetTexture(bitmap), x, y, w, h);
+			al_draw_tinted_bitmap_region(bitmap, tint, sx, sy, w, h, x, y, flags);
 		}
+		return;
+	}
+	CountDraw(game, GetTexture(bitmap), GetCharacterX(game, character), GetCharacterY(game, character),
+	          al_get_bitmap_width(bitmap) / character->spritesheet->cols, al_get_bitmap_height(bitmap) / character->spritesheet->rows);
+	DrawCharacter(game, character, tint, flags);
+}
+
+void DrawBatchedText(struct Game *game, ALLEGRO_FONT *font, ALLEGRO_COLOR color, float x, float y, int flags, const char *text, bool shadow) {
+	// Text is rendered once per string, font and colour; after that it's a single blit.
+	ALLEGRO_BITMAP *bitmap = GetCachedText(game, font, color, text, shadow, flags, &x, &y);
+	if (bitmap) {
+		DrawBatchedBitmap(game, bitmap, x, y, 0);
 	}
 }
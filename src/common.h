@@ -1,13 +1,160 @@
 #define LIBSUPERDERPY_DATA_TYPE struct CommonResources
 #include <libsuperderpy.h>
 
+struct PanelCache {
+		// Snapshot of whatever the panel depended on when it was last rendered.
+		void *state;
+		size_t size;
+		bool valid;
+};
+
+struct CharacterState {
+		struct Spritesheet *spritesheet;
+		int pos;
+		float x, y, angle;
+};
+
+enum {
+	// Draw statistics are kept per screen (0-3) and for the HUD.
+	STATS_SLOT_HUD = 4,
+	STATS_SLOTS
+};
+
+struct FrameStats {
+		int skipped_panels;
+		int draws[STATS_SLOTS];
+		int batches[STATS_SLOTS]; // texture changes, roughly one GPU draw call each
+};
+
+#define TEXT_CACHE_SIZE 32
+
+struct TextCacheEntry {
+		ALLEGRO_FONT *font;
+		unsigned char rgba[4];
+		bool shadow;
+		char *text;
+		ALLEGRO_BITMAP *bitmap;
+		int x, y; // pen position inside the bitmap
+		int width; // advance, for alignment
+		unsigned int used;
+};
+
+struct SpriteTrim {
+		char *character, *spritesheet;
+		int frames;
+		int (*rects)[4]; // x y w h of the opaque area of every frame, w < 0 when unknown
+};
+
+struct AtlasEntry {
+		char *character, *spritesheet;
+		int page;
+		int x, y, w, h;
+};
+
+#define OVERDRAW_RECTS 64
+
+enum ResourceType {
+	RESOURCE_BITMAP,
+	RESOURCE_FONT,
+	RESOURCE_SAMPLE
+};
+
+struct Asset {
+		enum ResourceType type;
+		const char *filename;
+		void *target; // pointer to where the loaded object goes
+		int size, flags; // fonts only
+};
+
+struct MusicTrack {
+		ALLEGRO_AUDIO_STREAM *stream;
+		float gain;
+};
+
+struct Voice {
+		char *id;
+		char filename[64];
+		ALLEGRO_SAMPLE *sample; // decoded, NULL while it's only streamed
+		size_t size; // of its file, 0 until it's been looked at
+		bool queued; // its decoding is on the asset queue and not counted yet
+		double used; // when it was last started
+		int playing;
+		struct Voice *next;
+};
+
+struct VoiceLine {
+		struct Voice *voice;
+		ALLEGRO_AUDIO_STREAM *stream;
+		ALLEGRO_SAMPLE_INSTANCE *instance;
+		char *text; // its subtitle
+		int slot; // in the voices' active lines, -1 if not there
+		bool started;
+		bool finished; // set on the audio thread
+		bool done; // finish dispatched on the main thread
+};
+
+#define VOICE_SLOTS 8
+
+#define FX_VOICES 8
+
+enum FxPriority {
+	FX_PRIORITY_LOW,
+	FX_PRIORITY_NORMAL,
+	FX_PRIORITY_HIGH
+};
+
+struct FxSound {
+		ALLEGRO_SAMPLE *sample;
+		int polyphony; // copies allowed to play at once
+		enum FxPriority priority;
+};
+
+struct FxVoice {
+		ALLEGRO_SAMPLE_INSTANCE *instance;
+		ALLEGRO_SAMPLE *sample; // set on the instance, NULL if none
+		struct FxSound *sound; // what it played last
+		double started;
+};
+
+#define DATA_PATH_BUCKETS 256
+
+struct DataPath {
+		char *name; // relative to the data directory
+		char *path;
+		struct DataPath *next;
+};
+
+struct Resource {
+		enum ResourceType type;
+		char *filename; // relative to the data directory
+		int size, flags; // fonts only
+		void *object;
+		int refs;
+		struct Resource *next;
+};
+
 struct CommonResources {
 		// Fill in with common data accessible from all gamestates.
+		ALLEGRO_BITMAP *strip, *bg;
+		ALLEGRO_BITMAP *frame; // whole viewport, NULL unless rendering at native resolution
 		ALLEGRO_BITMAP *atari;
 		ALLEGRO_BITMAP *floppy;
 		ALLEGRO_BITMAP *pegasus;
 		ALLEGRO_BITMAP *tape;
+		struct PanelCache panels[4];
 		int offset;
+		bool culling;
+		bool stage_running;
+
+		struct {
+				bool enabled;
+				bool redraw; // something visible changed since the frame was last composed
+				bool compose; // whether the frame being drawn gets composed at all
+				int offset; // render offset the frame was last composed at
+				bool focused;
+				int background_fps; // composition rate while the display is out of focus, 0 for unlimited
+				double last_compose;
+		} idle;
 		int current_screen;
 		int desired_screen;
 		bool forward;
@@ -20,6 +167,13 @@ struct CommonResources {
 		int mousex, mousey;
 		bool mouse_visible;
 
+		struct {
+				ALLEGRO_BITMAP *bitmap;
+				ALLEGRO_MOUSE_CURSOR *hardware; // NULL when falling back to drawing it ourselves
+				bool enabled[4]; // whether the screen wants a pointer over it
+				bool shown;
+		} cursor;
+
 		bool tutorial;
 
 		bool won;
@@ -35,8 +189,82 @@ struct CommonResources {
 				bool tape;
 		} status;
 
-		ALLEGRO_SAMPLE *sample;
-		ALLEGRO_SAMPLE_INSTANCE *sample_instance;
+		struct FxSound warning;
+
+		struct FxVoice fx[FX_VOICES];
+
+		struct {
+				struct FrameStats last; // the last composed frame
+				struct FrameStats pending; // accumulated by the frame being drawn
+		} stats;
+
+		struct TextCacheEntry text_cache[TEXT_CACHE_SIZE];
+		unsigned int text_cache_clock;
+
+		struct {
+				int slot; // -1 when not batching
+				const void *texture;
+		} batch;
+
+		struct {
+				void *file; // mapped data.pak
+				size_t size;
+				const struct DataArchiveEntry *entries;
+				int count;
+		} archive;
+
+		struct DataPath *data_paths[DATA_PATH_BUCKETS];
+
+		struct {
+				struct Voice *list;
+				size_t cached, limit; // bytes of decoded voice lines
+				struct VoiceLine *active[VOICE_SLOTS]; // playing, watched by the audio thread
+				unsigned int generation, seen; // bumped for each line that finishes
+		} voices;
+
+		struct {
+				struct MusicTrack current;
+				struct MusicTrack previous; // fading out
+				float step; // gain change per tick while fading
+		} music;
+
+		struct {
+				char *dir; // NULL when disabled
+				unsigned int frequency; // what the fx mixer wants
+				ALLEGRO_CHANNEL_CONF channels;
+				ALLEGRO_AUDIO_DEPTH depth;
+				ALLEGRO_MUTEX *mutex;
+				struct SampleMapping *mappings; // cache entries in use by samples
+		} sample_cache;
+
+		char *texture_cache; // directory with decoded bitmaps, NULL when disabled
+
+		struct Resource *resources;
+		struct Loader *asset_queue; // assets decoding in the background
+
+		struct SpriteTrim *trims;
+		int trim_count;
+
+		struct {
+				void *file; // mapped sprites/manifest.bin, unless it's read from the archive
+				size_t size;
+				const struct SpriteManifestRecord *records;
+				int count;
+				double time; // spent registering spritesheets so far
+		} manifest;
+
+		struct {
+				ALLEGRO_BITMAP **pages;
+				int page_count;
+				struct AtlasEntry *entries;
+				int count;
+		} atlas;
+
+		struct {
+				bool enabled;
+				int count[STATS_SLOTS];
+				float rects[STATS_SLOTS][OVERDRAW_RECTS][4]; // areas filled by the last render of each slot
+		} overdraw;
 };
 
 struct CommonResources* CreateGameData(struct Game *game);
@@ -44,6 +272,92 @@ void DestroyGameData(struct Game *game, struct CommonResources *resources);
 bool GlobalEventHandler(struct Game *game, ALLEGRO_EVENT *event);
 void StartGame(struct Game *game);
 void UpdateStatus(struct Game *game);
+bool IsScreenVisible(struct Game *game, int screen);
+int GetScreenX(struct Game *game, int screen);
+void GetCharacterState(struct Character *character, struct CharacterState *state);
+bool BeginPanelDraw(struct Game *game, int screen, ALLEGRO_BITMAP *panel, const void *state, size_t size);
+void InvalidatePanels(struct Game *game);
+void RequestRedraw(struct Game *game);
+bool BeginComposition(struct Game *game);
+void FinishFrameStats(struct Game *game);
+void BeginBatch(struct Game *game, int slot);
+void FlushBatch(struct Game *game);
+void EndBatch(struct Game *game);
+void DrawBatchedBitmap(struct Game *game, ALLEGRO_BITMAP *bitmap, float x, float y, int flags);
+void DrawBatchedCharacter(struct Game *game, struct Character *character, ALLEGRO_COLOR tint, int flags);
+ALLEGRO_BITMAP* GetCachedText(struct Game *game, ALLEGRO_FONT *font, ALLEGRO_COLOR color, const char *text, bool shadow, int flags, float *x, float *y);
+void InvalidateTextCache(struct Game *game, ALLEGRO_FONT *font);
+void* MapFile(const char *filename, size_t *size);
+void UnmapFile(void *data, size_t size);
+void InitVoices(struct Game *game, struct CommonResources *data);
+void DestroyVoices(struct Game *game);
+struct VoiceLine* CreateVoiceLine(struct Game *game, const char *id);
+void StartVoiceLine(struct Game *game, struct VoiceLine *line, char *text);
+bool IsVoiceLineFinished(struct VoiceLine *line);
+void DispatchVoiceEvents(struct Game *game);
+void InitFx(struct Game *game, struct CommonResources *data);
+void DestroyFx(struct Game *game);
+bool PlayFx(struct Game *game, struct FxSound *sound);
+void StopFx(struct Game *game, struct FxSound *sound);
+void DestroyVoiceLine(struct Game *game, struct VoiceLine *line);
+void PlayMusic(struct Game *game, const char *filename, float fade);
+void UpdateMusic(struct Game *game);
+void StopMusic(struct Game *game);
+void IndexDataPaths(struct Game *game, struct CommonResources *data);
+void DestroyDataPaths(struct Game *game);
+const char* FindDataPath(struct Game *game, const char *filename);
+const char* ResolveDataPath(struct Game *game, const char *filename);
+void OpenDataArchive(struct Game *game, struct CommonResources *data);
+void CloseDataArchive(struct Game *game);
+const void* GetArchivedFile(struct Game *game, const char *filename, size_t *size);
+ALLEGRO_FILE* OpenMemoryFile(const void *contents, size_t size);
+ALLEGRO_FILE* OpenDataFile(struct Game *game, const char *filename);
+const char* GetFileExtension(const char *filename);
+uint64_t HashContents(const void *contents, size_t size);
+char* CreateCacheDirectory(struct Game *game, const char *name);
+void OpenTextureCache(struct Game *game, struct CommonResources *data);
+void CloseTextureCache(struct Game *game);
+ALLEGRO_BITMAP* DecodeBitmap(struct Game *game, const char *filename, const void *contents, size_t size);
+ALLEGRO_BITMAP* DecodeBitmapFile(struct Game *game, const char *path);
+void OpenSampleCache(struct Game *game, struct CommonResources *data);
+void CloseSampleCache(struct Game *game);
+ALLEGRO_SAMPLE* DecodeSample(struct Game *game, const char *filename, const void *contents, size_t size);
+ALLEGRO_SAMPLE* DecodeSampleFile(struct Game *game, const char *path);
+void DestroySample(struct Game *game, ALLEGRO_SAMPLE *sample);
+ALLEGRO_BITMAP* LoadDataBitmap(struct Game *game, const char *filename);
+ALLEGRO_SAMPLE* LoadDataSample(struct Game *game, const char *filename);
+ALLEGRO_AUDIO_STREAM* LoadDataAudioStream(struct Game *game, const char *filename, size_t buffers, unsigned int samples);
+ALLEGRO_FONT* LoadDataTTF(struct Game *game, const char *filename, int size, int flags);
+ALLEGRO_CONFIG* LoadDataConfig(struct Game *game, const char *filename);
+void* LookupResource(struct Game *game, enum ResourceType type, const char *filename, int size, int flags);
+void AddResource(struct Game *game, enum ResourceType type, const char *filename, int size, int flags, void *object);
+void LoadAssets(struct Game *game, struct Asset *assets, int count, void (*progress)(struct Game*));
+void QueueAssets(struct Game *game, struct Asset *assets, int count, void (*progress)(struct Game*));
+void PumpAssets(struct Game *game);
+void WaitForAssets(struct Game *game);
+void DestroyAssetQueue(struct Game *game);
+ALLEGRO_BITMAP* AcquireBitmap(struct Game *game, const char *filename);
+ALLEGRO_FONT* LoadFont(struct Game *game, const char *filename, int size, int flags);
+ALLEGRO_FONT* AcquireFont(struct Game *game, const char *filename, int size, int flags);
+ALLEGRO_SAMPLE* AcquireSample(struct Game *game, const char *filename);
+void ReleaseResource(struct Game *game, void *object);
+void ReportResources(struct Game *game);
+void DestroyResources(struct Game *game);
+void LoadSpriteTrims(struct Game *game, struct CommonResources *data);
+void DestroySpriteTrims(struct Game *game);
+void LoadSpriteManifest(struct Game *game, struct CommonResources *data);
+void DestroySpriteManifest(struct Game *game);
+void RegisterCharacterSpritesheet(struct Game *game, struct Character *character, char *name);
+void LoadSpriteAtlas(struct Game *game, struct CommonResources *data);
+void DestroySpriteAtlas(struct Game *game);
+void LoadCharacterSpritesheets(struct Game *game, struct Character *character);
+bool GetCharacterTrim(struct Game *game, struct Character *character, int flags, float *x, float *y, int *sx, int *sy, int *w, int *h);
+void DrawBatchedText(struct Game *game, ALLEGRO_FONT *font, ALLEGRO_COLOR color, float x, float y, int flags, const char *text, bool shadow);
+bool IsCursorVisible(struct Game *game);
+void DrawCursor(struct Game *game);
+void SetFrameTarget(struct Game *game);
+void PresentFrame(struct Game *game);
+void WindowToViewport(struct Game *game, int x, int y, int *vx, int *vy);
 
 typedef enum {
 	DRSAUCE_EVENT_SWITCH_SCREEN = 512,
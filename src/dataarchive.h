@@ -0,0 +1,46 @@
+/*! \file dataarchive.h
+ *  \brief On-disk format of the packed data archive.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+// Written by tools/packdata, mapped by the game once at startup. A header,
+// then an index of entries sorted by path (so lookups are a binary search),
+// then the contents of every file, each aligned to DATA_ARCHIVE_ALIGN bytes,
+// in the order the game roughly needs them. Native byte order, like the
+// sprite manifest, which gets used in place from the mapping.
+
+#include <stdint.h>
+
+#define DATA_ARCHIVE_MAGIC "DSPK"
+#define DATA_ARCHIVE_VERSION 1
+#define DATA_ARCHIVE_PATH 64
+#define DATA_ARCHIVE_ALIGN 8
+
+struct DataArchiveHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t count;
+		uint32_t reserved;
+};
+
+struct DataArchiveEntry {
+		char path[DATA_ARCHIVE_PATH]; // relative to the data directory, with forward slashes
+		uint64_t offset; // from the start of the archive
+		uint64_t size;
+};
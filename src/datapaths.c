@@ -0,0 +1,141 @@
+/*! \file datapaths.c
+ *  \brief Resolving data file names without probing the filesystem.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+// GetDataFilePath looks for the file in each of the possible data
+// directories every time it's asked. Instead, the directory holding the
+// game's data is walked once at startup and every file in it is put into
+// a hash table under its name relative to that directory. Names that
+// aren't there fall back to GetDataFilePath, once; the answer is kept.
+//
+// Build-time tools write into the build tree, not the data directory. When
+// that's around (running without installing), it's indexed after the data
+// directory, so what's generated there takes precedence.
+
+static unsigned int HashName(const char *name) {
+	// FNV-1a
+	unsigned int hash = 2166136261u;
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash % DATA_PATH_BUCKETS;
+}
+
+static void AddDataPath(struct CommonResources *data, const char *name, const char *path) {
+	struct DataPath *entry = malloc(sizeof(struct DataPath));
+	unsigned int bucket = HashName(name);
+	entry->name = strdup(name);
+	entry->path = strdup(path);
+	entry->next = data->data_paths[bucket];
+	data->data_paths[bucket] = entry;
+}
+
+static int IndexDirectory(struct CommonResources *data, ALLEGRO_FS_ENTRY *dir, const char *prefix) {
+	int count = 0;
+	if (!al_open_directory(dir)) {
+		return 0;
+	}
+	ALLEGRO_FS_ENTRY *entry;
+	while ((entry = al_read_directory(dir))) {
+		ALLEGRO_PATH *path = al_create_path(al_get_fs_entry_name(entry));
+		char name[1024];
+		snprintf(name, 1024, "%s%s", prefix, al_get_path_filename(path));
+		if (al_get_fs_entry_mode(entry) & ALLEGRO_FILEMODE_ISDIR) {
+			// directories come back without a trailing separator
+			char subprefix[1024];
+			snprintf(subprefix, 1024, "%s/", name);
+			count += IndexDirectory(data, entry, subprefix);
+		} else {
+			AddDataPath(data, name, al_get_fs_entry_name(entry));
+			count++;
+		}
+		al_destroy_path(path);
+		al_destroy_fs_entry(entry);
+	}
+	al_close_directory(dir);
+	return count;
+}
+
+void IndexDataPaths(struct Game *game, struct CommonResources *data) {
+	if (!atoi(GetConfigOptionDefault(game, "DrSauce", "data_path_index", "1"))) {
+		return;
+	}
+	double start = al_get_time();
+	// the stage background is always there, so it tells where the data lives
+	ALLEGRO_PATH *path = al_create_path(GetDataFilePath(game, "stage.png"));
+	al_set_path_filename(path, NULL);
+	ALLEGRO_FS_ENTRY *dir = al_create_fs_entry(al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP));
+	int count = IndexDirectory(data, dir, "");
+	al_destroy_fs_entry(dir);
+	PrintConsole(game, "Indexed %d data files in %s in %.1f ms", count, al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP),
+	             (al_get_time() - start) * 1000);
+	al_destroy_path(path);
+#ifdef DRSAUCE_GENERATED_DATA
+	dir = al_create_fs_entry(DRSAUCE_GENERATED_DATA);
+	if (al_fs_entry_exists(dir)) {
+		count = IndexDirectory(data, dir, "");
+		PrintConsole(game, "Indexed %d generated data files in %s", count, DRSAUCE_GENERATED_DATA);
+	}
+	al_destroy_fs_entry(dir);
+#endif
+}
+
+void DestroyDataPaths(struct Game *game) {
+	int i;
+	for (i = 0; i < DATA_PATH_BUCKETS; i++) {
+		while (game->data->data_paths[i]) {
+			struct DataPath *entry = game->data->data_paths[i];
+			game->data->data_paths[i] = entry->next;
+			free(entry->name);
+			free(entry->path);
+			free(entry);
+		}
+	}
+}
+
+const char* FindDataPath(struct Game *game, const char *filename) {
+	// Only looks into the index; for files that may well not exist.
+	struct DataPath *entry;
+	for (entry = game->data->data_paths[HashName(filename)]; entry; entry = entry->next) {
+		if (!strcmp(entry->name, filename)) {
+			return entry->path;
+		}
+	}
+	return NULL;
+}
+
+const char* ResolveDataPath(struct Game *game, const char *filename) {
+	// Drop-in replacement for GetDataFilePath. The result stays valid until the
+	// game data is destroyed. Display thread only, as it may add to the index.
+	const char *path = FindDataPath(game, filename);
+	if (path) {
+		return path;
+	}
+	path = GetDataFilePath(game, (char*)filename);
+	if (!path) {
+		return NULL;
+	}
+	AddDataPath(game->data, filename, path);
+	return game->data->data_paths[HashName(filename)]->path;
+}
@@ -0,0 +1,122 @@
+/*! \file fx.c
+ *  \brief Pool of sound effect voices with polyphony limits and priorities.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+// All sound effects share a fixed set of sample instances on the fx mixer,
+// created up front. A sound says how many of its copies may play at once
+// and how important it is; once it hits its own limit it restarts its
+// oldest copy, and when every voice is busy it takes over the oldest one
+// playing something no more important than itself. If there's none, the
+// trigger is dropped. Playing a sound never allocates anything.
+
+void InitFx(struct Game *game, struct CommonResources *data) {
+	int i;
+	for (i = 0; i < FX_VOICES; i++) {
+		// attached once there's a sample to play
+		data->fx[i].instance = al_create_sample_instance(NULL);
+		data->fx[i].sample = NULL;
+		data->fx[i].sound = NULL;
+		data->fx[i].started = 0;
+	}
+}
+
+void DestroyFx(struct Game *game) {
+	int i;
+	for (i = 0; i < FX_VOICES; i++) {
+		al_destroy_sample_instance(game->data->fx[i].instance);
+		game->data->fx[i].instance = NULL;
+		game->data->fx[i].sound = NULL;
+	}
+}
+
+bool PlayFx(struct Game *game, struct FxSound *sound) {
+	struct FxVoice *idle = NULL, *oldest = NULL, *victim = NULL;
+	int copies = 0;
+	int i;
+
+	if (!sound->sample) {
+		return false;
+	}
+
+	for (i = 0; i < FX_VOICES; i++) {
+		struct FxVoice *voice = &game->data->fx[i];
+		if (!voice->sound || !al_get_sample_instance_playing(voice->instance)) {
+			// one that already holds this sample doesn't even need al_set_sample
+			if (!idle || (voice->sample == sound->sample)) {
+				idle = voice;
+			}
+			continue;
+		}
+		if (voice->sound == sound) {
+			copies++;
+			if (!oldest || (voice->started < oldest->started)) {
+				oldest = voice;
+			}
+		}
+		if (voice->sound->priority > sound->priority) {
+			continue;
+		}
+		if (!victim || (voice->sound->priority < victim->sound->priority) ||
+		    ((voice->sound->priority == victim->sound->priority) && (voice->started < victim->started))) {
+			victim = voice;
+		}
+	}
+
+	struct FxVoice *voice = victim;
+	if (copies >= sound->polyphony) {
+		voice = oldest;
+	} else if (idle) {
+		voice = idle;
+	}
+	if (!voice) {
+		return false; // everything playing is more important
+	}
+
+	if (voice->sample != sound->sample) {
+		al_set_sample(voice->instance, sound->sample); // stops it, keeps it attached
+		voice->sample = sound->sample;
+	} else {
+		al_stop_sample_instance(voice->instance);
+	}
+	if (!al_get_sample_instance_attached(voice->instance)) {
+		al_attach_sample_instance_to_mixer(voice->instance, game->audio.fx);
+	}
+	al_set_sample_instance_position(voice->instance, 0);
+	voice->sound = sound;
+	voice->started = al_get_time();
+	al_play_sample_instance(voice->instance);
+	return true;
+}
+
+void StopFx(struct Game *game, struct FxSound *sound) {
+	// Must be called before the sound's sample is released.
+	int i;
+	for (i = 0; i < FX_VOICES; i++) {
+		struct FxVoice *voice = &game->data->fx[i];
+		if (voice->sound == sound) {
+			al_set_sample(voice->instance, NULL); // also detaches it
+			voice->sample = NULL;
+			voice->sound = NULL;
+		}
+	}
+}
@@ -39,7 +39,14 @@ struct GamestateResources {
 		int counter;
 };
 
-int Gamestate_ProgressCount = 1; // number of loading steps as reported by Gamestate_Load
+struct PanelState {
+		// Everything Gamestate_Draw depends on; the panel is re-rendered only when it changes.
+		struct CharacterState atari, meter, shovel;
+		float temperature;
+		bool shovel_visible, shovel_flipped, front;
+};
+
+int Gamestate_ProgressCount = 2; // number of loading steps as reported by Gamestate_Load
 
 void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 	// Called 60 times per second. Here you should do all your game logic.
@@ -101,35 +108,52 @@ void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 void Gamestate_Draw(struct Game *game, struct GamestateResources* data) {
 	// Called as soon as possible, but no sooner than next Gamestate_Logic call.
 	// Draw everything to the screen here.
-	al_set_target_bitmap(game->data->atari);
-	al_clear_to_color(al_map_rgba(0,0,0,0));
-	al_draw_bitmap(data->coal, 7, 52, 0);
+	struct PanelState state;
+	memset(&state, 0, sizeof(state));
+	GetCharacterState(data->atari, &state.atari);
+	GetCharacterState(data->meter, &state.meter);
+	state.temperature = data->temperature;
+	state.shovel_visible = game->data->mouse_visible;
+	if (state.shovel_visible) {
+		GetCharacterState(data->shovel, &state.shovel);
+		state.shovel_flipped = game->data->mousex > 140 && !data->shovel_locked && !data->shovel_full;
+	}
+	state.front = game->data->mousey < 120;
+	if (!BeginPanelDraw(game, 0, game->data->atari, &state, sizeof(state))) {
+		return;
+	}
+	BeginBatch(game, 0);
+
+	DrawBatchedBitmap(game, data->coal, 7, 52, 0);
 
-	DrawCharacter(game, data->atari, al_map_rgb(255,255,255), 0);
-	DrawCharacter(game, data->meter, al_map_rgb(255,255,255), 0);
+	DrawBatchedCharacter(game, data->atari, al_map_rgb(255,255,255), 0);
+	DrawBatchedCharacter(game, data->meter, al_map_rgb(255,255,255), 0);
 	int x = GetCharacterX(game, data->meter) + 18, y = GetCharacterY(game, data->meter) + 11;
 	float angle = (data->temperature / 100.0) * ALLEGRO_PI;
+	FlushBatch(game);
 	al_draw_line(x, y, x-(cos(angle)*11), y-(sin(angle)*9), al_map_rgb(50,50,50), 1);
 	al_draw_filled_rectangle(x-1, y, x+1, y+2, al_map_rgb(0,0,0));
 
-	if (game->data->mouse_visible) {
-		if (game->data->mousex > 140 && !data->shovel_locked && !data->shovel_full) {
-			DrawCharacter(game, data->shovel, al_map_rgb(255,255,255), ALLEGRO_FLIP_HORIZONTAL);
+	if (state.shovel_visible) {
+		if (state.shovel_flipped) {
+			DrawBatchedCharacter(game, data->shovel, al_map_rgb(255,255,255), ALLEGRO_FLIP_HORIZONTAL);
 		} else {
-			DrawCharacter(game, data->shovel, al_map_rgb(255,255,255), 0);
+			DrawBatchedCharacter(game, data->shovel, al_map_rgb(255,255,255), 0);
 		}
 	}
 
-	if (game->data->mousey < 120) {
-		DrawCharacter(game, data->atari, al_map_rgb(255,255,255), 0);
-		DrawCharacter(game, data->meter, al_map_rgb(255,255,255), 0);
+	if (state.front) {
+		DrawBatchedCharacter(game, data->atari, al_map_rgb(255,255,255), 0);
+		DrawBatchedCharacter(game, data->meter, al_map_rgb(255,255,255), 0);
 		int x = GetCharacterX(game, data->meter) + 18, y = GetCharacterY(game, data->meter) + 11;
 		float angle = (data->temperature / 100.0) * ALLEGRO_PI;
+		FlushBatch(game);
 		al_draw_line(x, y, x-(cos(angle)*11), y-(sin(angle)*9), al_map_rgb(50,50,50), 1);
 		al_draw_filled_rectangle(x-1, y, x+1, y+2, al_map_rgb(0,0,0));
 	}
 
-	al_set_target_backbuffer(game->display);
+	EndBatch(game);
+	SetFrameTarget(game);
 }
 
 bool FillShovel(struct Game *game, struct TM_Action *action, enum TM_ActionState state) {
@@ -196,26 +220,29 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 	struct GamestateResources *data = malloc(sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can draw a progress bar
 
-	data->coal = al_load_bitmap(GetDataFilePath(game, "coal.png"));
+	struct Asset assets[] = {
+		{RESOURCE_BITMAP, "coal.png", &data->coal},
+	};
+	QueueAssets(game, assets, sizeof(assets) / sizeof(assets[0]), progress); // decoded while the intro plays
 
 	data->atari = CreateCharacter(game, "atari");
-	RegisterSpritesheet(game, data->atari, "burn");
-	LoadSpritesheets(game, data->atari);
+	RegisterCharacterSpritesheet(game, data->atari, "burn");
+	LoadCharacterSpritesheets(game, data->atari);
 	SelectSpritesheet(game, data->atari, "burn");
 
 	data->shovel = CreateCharacter(game, "shovel");
-	RegisterSpritesheet(game, data->shovel, "shovel");
-	RegisterSpritesheet(game, data->shovel, "use");
-	RegisterSpritesheet(game, data->shovel, "full");
-	LoadSpritesheets(game, data->shovel);
+	RegisterCharacterSpritesheet(game, data->shovel, "shovel");
+	RegisterCharacterSpritesheet(game, data->shovel, "use");
+	RegisterCharacterSpritesheet(game, data->shovel, "full");
+	LoadCharacterSpritesheets(game, data->shovel);
 	SelectSpritesheet(game, data->shovel, "shovel");
 
 	data->meter = CreateCharacter(game, "meter");
-	RegisterSpritesheet(game, data->meter, "meter");
-	RegisterSpritesheet(game, data->meter, "meter-red");
-	RegisterSpritesheet(game, data->meter, "meter-orange");
-	RegisterSpritesheet(game, data->meter, "meter-green");
-	LoadSpritesheets(game, data->meter);
+	RegisterCharacterSpritesheet(game, data->meter, "meter");
+	RegisterCharacterSpritesheet(game, data->meter, "meter-red");
+	RegisterCharacterSpritesheet(game, data->meter, "meter-orange");
+	RegisterCharacterSpritesheet(game, data->meter, "meter-green");
+	LoadCharacterSpritesheets(game, data->meter);
 	SelectSpritesheet(game, data->meter, "meter-orange");
 
 	data->timeline = TM_Init(game, "atari");
@@ -226,7 +253,8 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game *game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_bitmap(data->coal);
+	WaitForAssets(game); // nothing may still be on its way into data
+	ReleaseResource(game, data->coal);
 	DestroyCharacter(game, data->atari);
 	DestroyCharacter(game, data->shovel);
 	DestroyCharacter(game, data->meter);
@@ -140,11 +140,15 @@ void Gamestate_Draw(struct Game *game, struct GamestateResources* data) {
 
 		al_draw_bitmap(data->checkerboard, 0, 0, 0);
 
-		al_set_target_backbuffer(game->display);
+		SetFrameTarget(game);
 
 		al_draw_bitmap(data->pixelator, 0, 0, 0);
 
+	} else {
+		SetFrameTarget(game);
+		al_clear_to_color(al_map_rgb(0,0,0));
 	}
+	PresentFrame(game);
 }
 
 void Gamestate_Start(struct Game *game, struct GamestateResources* data) {
@@ -199,22 +203,21 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 	al_set_target_backbuffer(game->display);
 	(*progress)(game);
 
-	data->font = al_load_ttf_font(GetDataFilePath(game, "fonts/DejaVuSansMono.ttf"),
-	                              (int)(game->viewport.height*0.1666 / 8) * 8 ,0 );
+	data->font = LoadFont(game, "fonts/DejaVuSansMono.ttf", DRSAUCE_LOGO_FONT_SIZE, 0); // the size it's baked at
 	(*progress)(game);
-	data->sample = al_load_sample( GetDataFilePath(game, "dosowisko.flac") );
+	data->sample = LoadDataSample(game, "dosowisko.flac");
 	data->sound = al_create_sample_instance(data->sample);
 	al_attach_sample_instance_to_mixer(data->sound, game->audio.music);
 	al_set_sample_instance_playmode(data->sound, ALLEGRO_PLAYMODE_ONCE);
 	(*progress)(game);
 
-	data->kbd_sample = al_load_sample( GetDataFilePath(game, "kbd.flac") );
+	data->kbd_sample = LoadDataSample(game, "kbd.flac");
 	data->kbd = al_create_sample_instance(data->kbd_sample);
 	al_attach_sample_instance_to_mixer(data->kbd, game->audio.fx);
 	al_set_sample_instance_playmode(data->kbd, ALLEGRO_PLAYMODE_ONCE);
 	(*progress)(game);
 
-	data->key_sample = al_load_sample( GetDataFilePath(game, "key.flac") );
+	data->key_sample = LoadDataSample(game, "key.flac");
 	data->key = al_create_sample_instance(data->key_sample);
 	al_attach_sample_instance_to_mixer(data->key, game->audio.fx);
 	al_set_sample_instance_playmode(data->key, ALLEGRO_PLAYMODE_ONCE);
@@ -232,11 +235,11 @@ void Gamestate_Stop(struct Game *game, struct GamestateResources* data) {
 void Gamestate_Unload(struct Game *game, struct GamestateResources* data) {
 	al_destroy_font(data->font);
 	al_destroy_sample_instance(data->sound);
-	al_destroy_sample(data->sample);
+	DestroySample(game, data->sample);
 	al_destroy_sample_instance(data->kbd);
-	al_destroy_sample(data->kbd_sample);
+	DestroySample(game, data->kbd_sample);
 	al_destroy_sample_instance(data->key);
-	al_destroy_sample(data->key_sample);
+	DestroySample(game, data->key_sample);
 	al_destroy_bitmap(data->bitmap);
 	al_destroy_bitmap(data->checkerboard);
 	al_destroy_bitmap(data->pixelator);
@@ -30,7 +30,6 @@ struct GamestateResources {
 		ALLEGRO_BITMAP *floppy;
 		struct Character *floppies;
 		struct Character *progress;
-		struct Character *cursor;
 		int nr_inside;
 		bool taken;
 		int taken_nr;
@@ -43,12 +42,19 @@ struct GamestateResources {
 		int chance;
 };
 
-int Gamestate_ProgressCount = 1; // number of loading steps as reported by Gamestate_Load
+struct PanelState {
+		// Everything Gamestate_Draw depends on; the panel is re-rendered only when it changes.
+		struct CharacterState floppies, progress;
+		bool needs_change, blink, taken;
+		int needed, taken_nr;
+};
+
+int Gamestate_ProgressCount = 5; // number of loading steps as reported by Gamestate_Load
 
 void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 	// Called 60 times per second. Here you should do all your game logic.
 	AnimateCharacter(game, data->progress, 1);
-	SetCharacterPosition(game, data->cursor, game->data->mousex, game->data->mousey, 0);
+	game->data->cursor.enabled[3] = !data->taken;
 	data->blink++;
 
 	if (data->needed == data->nr_inside) {
@@ -68,33 +74,48 @@ void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 void Gamestate_Draw(struct Game *game, struct GamestateResources* data) {
 	// Called as soon as possible, but no sooner than next Gamestate_Logic call.
 	// Draw everything to the screen here.
-	al_set_target_bitmap(game->data->floppy);
-	al_clear_to_color(al_map_rgba(0,0,0,0));
-	al_draw_bitmap(data->pc, 1022-960, 20, 0);
-	DrawCharacter(game, data->floppies, al_map_rgb(255,255,255), 0);
+	struct PanelState state;
+	memset(&state, 0, sizeof(state));
+	GetCharacterState(data->floppies, &state.floppies);
+	state.needs_change = data->needs_change;
+	if (state.needs_change) {
+		state.blink = (data->blink / 30) % 2;
+		state.needed = data->needed;
+	} else {
+		GetCharacterState(data->progress, &state.progress);
+	}
+	state.taken = data->taken;
+	if (state.taken) {
+		state.taken_nr = data->taken_nr;
+	}
+	if (!BeginPanelDraw(game, 3, game->data->floppy, &state, sizeof(state))) {
+		return;
+	}
+	BeginBatch(game, 3);
+
+	DrawBatchedBitmap(game, data->pc, 1022-960, 20, 0);
+	DrawBatchedCharacter(game, data->floppies, al_map_rgb(255,255,255), 0);
 
-	if (data->needs_change) {
-		if ((data->blink / 30) % 2) {
+	if (state.needs_change) {
+		if (state.blink) {
 			char text[8] = "DISK ??";
 			snprintf(text, 8, "DISK %d", data->needed);
-			DrawTextWithShadow(data->font_screen, al_map_rgb(255,255,255), 320/2 - 37, 60 - 2, ALLEGRO_ALIGN_CENTER, "INSERT");
-			DrawTextWithShadow(data->font_screen, al_map_rgb(255,255,255), 320/2 - 37, 75 - 4, ALLEGRO_ALIGN_CENTER, text);
+			DrawBatchedText(game, data->font_screen, al_map_rgb(255,255,255), 320/2 - 37, 60 - 2, ALLEGRO_ALIGN_CENTER, "INSERT", true);
+			DrawBatchedText(game, data->font_screen, al_map_rgb(255,255,255), 320/2 - 37, 75 - 4, ALLEGRO_ALIGN_CENTER, text, true);
 		}
 	} else {
-		DrawCharacter(game, data->progress, al_map_rgb(255,255,255), 0);
+		DrawBatchedCharacter(game, data->progress, al_map_rgb(255,255,255), 0);
 	}
 
 
-	if (game->data->mouse_visible && !data->taken) {
-		DrawCharacter(game, data->cursor, al_map_rgb(255,255,255), 0);
-	}
-	if (data->taken) {
-		al_draw_bitmap(data->floppy, 98, 27, 0);
+	if (state.taken) {
+		DrawBatchedBitmap(game, data->floppy, 98, 27, 0);
 		char text[8] = "DISK ??";
 		snprintf(text, 8, "DISK %d", data->taken_nr);
-		al_draw_text(data->font_disk, al_map_rgb(0,0,0), 320/2, 110, ALLEGRO_ALIGN_CENTER, text);
+		DrawBatchedText(game, data->font_disk, al_map_rgb(0,0,0), 320/2, 110, ALLEGRO_ALIGN_CENTER, text, false);
 	}
-	al_set_target_backbuffer(game->display);
+	EndBatch(game);
+	SetFrameTarget(game);
 }
 
 void Gamestate_ProcessEvent(struct Game *game, struct GamestateResources* data, ALLEGRO_EVENT *ev) {
@@ -144,40 +165,37 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 	struct GamestateResources *data = malloc(sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can draw a progress bar
 
-	data->pc = al_load_bitmap(GetDataFilePath(game, "pc.png"));
-	data->floppy = al_load_bitmap(GetDataFilePath(game, "floppy.png"));
+	struct Asset assets[] = {
+		{RESOURCE_BITMAP, "pc.png", &data->pc},
+		{RESOURCE_BITMAP, "floppy.png", &data->floppy},
+		{RESOURCE_FONT, "fonts/PerfectDOSVGA437.ttf", &data->font_disk, 16, 0},
+		{RESOURCE_FONT, "fonts/MonkeyIsland.ttf", &data->font_screen, 8, 0},
+	};
+	QueueAssets(game, assets, sizeof(assets) / sizeof(assets[0]), progress); // decoded while the intro plays
 
 	data->floppies = CreateCharacter(game, "floppies");
-	RegisterSpritesheet(game, data->floppies, "stack");
-	LoadSpritesheets(game, data->floppies);
+	RegisterCharacterSpritesheet(game, data->floppies, "stack");
+	LoadCharacterSpritesheets(game, data->floppies);
 	SelectSpritesheet(game, data->floppies, "stack");
 
 	data->progress = CreateCharacter(game, "progress");
-	RegisterSpritesheet(game, data->progress, "progress");
-	LoadSpritesheets(game, data->progress);
+	RegisterCharacterSpritesheet(game, data->progress, "progress");
+	LoadCharacterSpritesheets(game, data->progress);
 	SelectSpritesheet(game, data->progress, "progress");
 
-	data->cursor = CreateCharacter(game, "cursor");
-	RegisterSpritesheet(game, data->cursor, "pointer");
-	LoadSpritesheets(game, data->cursor);
-	SelectSpritesheet(game, data->cursor, "pointer");
-
-	data->font_disk = al_load_font(GetDataFilePath(game, "fonts/PerfectDOSVGA437.ttf"), 16, 0);
-	data->font_screen = al_load_font(GetDataFilePath(game, "fonts/MonkeyIsland.ttf"), 8, 0);
-
 	return data;
 }
 
 void Gamestate_Unload(struct Game *game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_bitmap(data->pc);
-	al_destroy_bitmap(data->floppy);
+	WaitForAssets(game); // nothing may still be on its way into data
+	ReleaseResource(game, data->pc);
+	ReleaseResource(game, data->floppy);
 	DestroyCharacter(game, data->floppies);
 	DestroyCharacter(game, data->progress);
-	DestroyCharacter(game, data->cursor);
-	al_destroy_font(data->font_disk);
-	al_destroy_font(data->font_screen);
+	ReleaseResource(game, data->font_disk);
+	ReleaseResource(game, data->font_screen);
 	free(data);
 }
 
@@ -197,6 +215,7 @@ void Gamestate_Start(struct Game *game, struct GamestateResources* data) {
 
 void Gamestate_Stop(struct Game *game, struct GamestateResources* data) {
 	// Called when gamestate gets stopped. Stop timers, music etc. here.
+	game->data->cursor.enabled[3] = false;
 }
 
 void Gamestate_Pause(struct Game *game, struct GamestateResources* data) {
@@ -20,6 +20,7 @@
  */
 
 #include "../common.h"
+#include <stdio.h>
 #include <libsuperderpy.h>
 
 struct GamestateResources {
@@ -27,35 +28,73 @@ struct GamestateResources {
 		// It gets created on load and then gets passed around to all other function calls.
 		ALLEGRO_FONT *font, *dialog;
 		int alpha;
+
+		// what the last logic tick left on screen, to notice changes
+		const char *shown_text;
+		int shown_alpha;
+		bool shown_tutorial;
 };
 
 int Gamestate_ProgressCount = 1; // number of loading steps as reported by Gamestate_Load
 
 void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 	// Called 60 times per second. Here you should do all your game logic.
+	PumpAssets(game);
+	UpdateMusic(game);
+	DispatchVoiceEvents(game);
 	if (game->data->text && data->alpha < 0) {
 		data->alpha+=1;
 	}
 	if (!game->data->text && data->alpha > -20) {
 		data->alpha-=1;
 	}
+
+	if ((data->shown_text != game->data->text) || (data->shown_alpha != data->alpha) || (data->shown_tutorial != game->data->tutorial)) {
+		data->shown_text = game->data->text;
+		data->shown_alpha = data->alpha;
+		data->shown_tutorial = game->data->tutorial;
+		RequestRedraw(game);
+	}
 }
 
 void Gamestate_Draw(struct Game *game, struct GamestateResources* data) {
 	// Called as soon as possible, but no sooner than next Gamestate_Logic call.
 	// Draw everything to the screen here.
+	if (!game->data->idle.compose) {
+		// nothing changed, the frame from last time is still there
+		PresentFrame(game);
+		return;
+	}
+	SetFrameTarget(game);
+	BeginBatch(game, STATS_SLOT_HUD);
 	if (!game->data->tutorial) {
-		DrawTextWithShadow(data->font, al_map_rgb(255,255,255), 10, game->viewport.height / 2 - 10,
-		             ALLEGRO_ALIGN_LEFT, "<");
-		DrawTextWithShadow(data->font, al_map_rgb(255,255,255), game->viewport.width - 10, game->viewport.height / 2 - 10,
-		             ALLEGRO_ALIGN_RIGHT, ">");
+		DrawBatchedText(game, data->font, al_map_rgb(255,255,255), 10, game->viewport.height / 2 - 10,
+		                ALLEGRO_ALIGN_LEFT, "<", true);
+		DrawBatchedText(game, data->font, al_map_rgb(255,255,255), game->viewport.width - 10, game->viewport.height / 2 - 10,
+		                ALLEGRO_ALIGN_RIGHT, ">", true);
 	}
 
+	FlushBatch(game);
 	al_draw_filled_rectangle(0, 0, 320, 20 + data->alpha, al_map_rgba(0,0,0,128));
 	if (game->data->text) {
-		DrawTextWithShadow(data->dialog, al_map_rgb(255,255,255), game->viewport.width / 2, 5 + data->alpha, ALLEGRO_ALIGN_CENTER, game->data->text);
+		DrawBatchedText(game, data->dialog, al_map_rgb(255,255,255), game->viewport.width / 2, 5 + data->alpha, ALLEGRO_ALIGN_CENTER, game->data->text, true);
+	}
+	EndBatch(game);
+
+	if (game->config.debug) {
+		// draws/batches per screen and for the HUD itself, from the previous frame
+		struct FrameStats *stats = &game->data->stats.last;
+		char text[255];
+		snprintf(text, 255, "skipped %d | %d/%d %d/%d %d/%d %d/%d | hud %d/%d", stats->skipped_panels,
+		         stats->draws[0], stats->batches[0], stats->draws[1], stats->batches[1],
+		         stats->draws[2], stats->batches[2], stats->draws[3], stats->batches[3],
+		         stats->draws[STATS_SLOT_HUD], stats->batches[STATS_SLOT_HUD]);
+		// changes every frame, so keep it out of the text cache
+		DrawTextWithShadow(data->dialog, al_map_rgb(255,255,255), 2, game->viewport.height - 10, ALLEGRO_ALIGN_LEFT, text);
 	}
 
+	PresentFrame(game);
+
 }
 
 void Gamestate_ProcessEvent(struct Game *game, struct GamestateResources* data, ALLEGRO_EVENT *ev) {
@@ -101,8 +140,7 @@ void Gamestate_ProcessEvent(struct Game *game, struct GamestateResources* data,
 	}
 
 	if (ev->type==ALLEGRO_EVENT_MOUSE_AXES) {
-		game->data->mousex = (ev->mouse.x / (float)al_get_display_width(game->display)) * game->viewport.width;
-		game->data->mousey = (ev->mouse.y / (float)al_get_display_height(game->display)) * game->viewport.height;
+		WindowToViewport(game, ev->mouse.x, ev->mouse.y, &game->data->mousex, &game->data->mousey);
 		game->data->mouse_visible = true;
 	}
 
@@ -115,8 +153,8 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 	// Called once, when the gamestate library is being loaded.
 	// Good place for allocating memory, loading bitmaps etc.
 	struct GamestateResources *data = malloc(sizeof(struct GamestateResources));
-	data->font = al_load_font(GetDataFilePath(game, "fonts/PerfectDOSVGA437.ttf"), 32, 0);
-	data->dialog = al_load_font(GetDataFilePath(game, "fonts/MonkeyIsland.ttf"), 8, 0);
+	data->font = AcquireFont(game, "fonts/PerfectDOSVGA437.ttf", 32, 0);
+	data->dialog = AcquireFont(game, "fonts/MonkeyIsland.ttf", 8, 0);
 	progress(game); // report that we progressed with the loading, so the engine can draw a progress bar
 	return data;
 }
@@ -124,8 +162,8 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game *game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_font(data->font);
-	al_destroy_font(data->dialog);
+	ReleaseResource(game, data->font);
+	ReleaseResource(game, data->dialog);
 	free(data);
 }
 
@@ -133,6 +171,10 @@ void Gamestate_Start(struct Game *game, struct GamestateResources* data) {
 	// Called when this gamestate gets control. Good place for initializing state,
 	// playing music etc.
 	data->alpha = -20;
+	data->shown_text = NULL;
+	data->shown_alpha = data->alpha;
+	data->shown_tutorial = game->data->tutorial;
+	RequestRedraw(game);
 }
 
 void Gamestate_Stop(struct Game *game, struct GamestateResources* data) {
@@ -32,20 +32,14 @@ struct GamestateResources {
 		//ALLEGRO_BITMAP *bg1, *bg2;
 		ALLEGRO_BITMAP *bird;
 
-		ALLEGRO_SAMPLE *music_sample;
-		ALLEGRO_SAMPLE_INSTANCE *music;
-		ALLEGRO_SAMPLE *music2_sample;
-		ALLEGRO_SAMPLE_INSTANCE *music2;
-
-		ALLEGRO_SAMPLE *sample;
-		ALLEGRO_SAMPLE_INSTANCE *sample_instance;
+		struct FxSound boom;
 
 		bool show;
 		bool finished;
 		int rotation;
 };
 
-int Gamestate_ProgressCount = 3; // number of loading steps as reported by Gamestate_Load
+int Gamestate_ProgressCount = 6; // number of loading steps as reported by Gamestate_Load
 
 void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 	// Called 60 times per second. Here you should do all your game logic.
@@ -55,6 +49,11 @@ void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 void Gamestate_Draw(struct Game *game, struct GamestateResources* data) {
 	// Called as soon as possible, but no sooner than next Gamestate_Logic call.
 	// Draw everything to the screen here.
+	if (game->data->stage_running) {
+		// fully covered by the stage
+		return;
+	}
+	SetFrameTarget(game);
 	al_draw_bitmap(data->bg, 0, 0, 0);
 	al_draw_bitmap(data->bird, 0, 0 ,0);
 	if (data->show) {
@@ -79,7 +78,7 @@ bool TimeTravel(struct Game *game, struct TM_Action *action, enum TM_ActionState
 	struct GamestateResources *data = TM_GetArg(action->arguments, 0);
 	if (state == TM_ACTIONSTATE_RUNNING) {
 		data->show = true;
-		al_play_sample_instance(data->sample_instance);
+		PlayFx(game, &data->boom);
 	}
 	return true;
 }
@@ -87,6 +86,10 @@ bool TimeTravel(struct Game *game, struct TM_Action *action, enum TM_ActionState
 bool StartOthers(struct Game *game, struct TM_Action *action, enum TM_ActionState state) {
 	//struct GamestateResources *data = TM_GetArg(action->arguments, 0);
 	if (state == TM_ACTIONSTATE_RUNNING) {
+		// their assets have been decoding since the intro started; usually
+		// they're all in by now, otherwise this is where we wait for them
+		WaitForAssets(game);
+		ReportResources(game); // everything StartGame asked for is in now
 		StartGamestate(game, "atari");
 		StartGamestate(game, "pegasus");
 		StartGamestate(game, "tape");
@@ -104,13 +107,11 @@ bool Finish(struct Game *game, struct TM_Action *action, enum TM_ActionState sta
 		game->data->desired_screen=2;
 		game->data->forward = true;
 		game->data->charge=0;
-		al_stop_sample_instance(data->music);
-		al_play_sample_instance(data->music2);
+		PlayMusic(game, "music2.flac", 1.0); // crossfade
 
 		int x, y;
 		al_get_mouse_cursor_position(&x, &y);
-		game->data->mousex = (x / (float)al_get_display_width(game->display)) * game->viewport.width;
-		game->data->mousey = (y / (float)al_get_display_height(game->display)) * game->viewport.height;
+		WindowToViewport(game, x, y, &game->data->mousex, &game->data->mousey);
 		game->data->mouse_visible = true;
 
 		ALLEGRO_EVENT ev;
@@ -141,29 +142,20 @@ bool Rotate(struct Game *game, struct TM_Action *action, enum TM_ActionState sta
 
 bool Speak(struct Game *game, struct TM_Action *action, enum TM_ActionState state) {
 //	struct GamestateResources *data = TM_GetArg(action->arguments, 0);
-	ALLEGRO_AUDIO_STREAM *stream = TM_GetArg(action->arguments, 1);
+	struct VoiceLine *line = TM_GetArg(action->arguments, 1);
 	char *text = TM_GetArg(action->arguments, 2);
 
-	if (state == TM_ACTIONSTATE_INIT) {
-		al_set_audio_stream_playing(stream, false);
-		al_set_audio_stream_playmode(stream, ALLEGRO_PLAYMODE_ONCE);
-	}
-
 	if (state == TM_ACTIONSTATE_START) {
 		game->data->skip = false;
-		//al_rewind_audio_stream(stream);
-		al_attach_audio_stream_to_mixer(stream, game->audio.voice);
-		al_set_audio_stream_playing(stream, true);
-
-		game->data->text = text;
+		StartVoiceLine(game, line, text); // opened only now
 	}
 
 	if (state == TM_ACTIONSTATE_RUNNING) {
-		return !al_get_audio_stream_playing(stream) || game->data->skip;
+		return IsVoiceLineFinished(line) || game->data->skip;
 	}
 
 	if (state == TM_ACTIONSTATE_DESTROY) {
-		al_destroy_audio_stream(stream);
+		DestroyVoiceLine(game, line);
 		game->data->text = NULL;
 	}
 	return false;
@@ -174,49 +166,37 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 	// Good place for allocating memory, loading bitmaps etc.
 	struct GamestateResources *data = malloc(sizeof(struct GamestateResources));
 	data->timeline = TM_Init(game, "intro");
-	progress(game); // report that we progressed with the loading, so the engine can draw a progress bar
-	data->bg = al_load_bitmap(GetDataFilePath(game, "bg.png"));
-	progress(game); // report that we progressed with the loading, so the engine can draw a progress bar
-
-	data->music_sample = al_load_sample(GetDataFilePath(game, "music1.flac"));
-	data->music = al_create_sample_instance(data->music_sample);
-	al_attach_sample_instance_to_mixer(data->music, game->audio.music);
-	al_set_sample_instance_playmode(data->music, ALLEGRO_PLAYMODE_LOOP);
-
-	data->music2_sample = al_load_sample(GetDataFilePath(game, "music2.flac"));
-	data->music2 = al_create_sample_instance(data->music2_sample);
-	al_attach_sample_instance_to_mixer(data->music2, game->audio.music);
-	al_set_sample_instance_playmode(data->music2, ALLEGRO_PLAYMODE_LOOP);
-
-	al_play_sample_instance(data->music);
-
 	progress(game); // report that we progressed with the loading, so the engine can draw a progress bar
 
-	data->machine = al_load_bitmap(GetDataFilePath(game, "machin.png"));
-	data->sos = al_load_bitmap(GetDataFilePath(game, "dr.png"));
-	data->bird = al_load_bitmap(GetDataFilePath(game, "pidgey.png"));
+	data->boom = (struct FxSound){.polyphony = 1, .priority = FX_PRIORITY_NORMAL};
+	struct Asset assets[] = {
+		{RESOURCE_BITMAP, "bg.png", &data->bg},
+		{RESOURCE_BITMAP, "machin.png", &data->machine},
+		{RESOURCE_BITMAP, "dr.png", &data->sos},
+		{RESOURCE_BITMAP, "pidgey.png", &data->bird},
+		{RESOURCE_SAMPLE, "boom.flac", &data->boom.sample},
+	};
+	LoadAssets(game, assets, sizeof(assets) / sizeof(assets[0]), progress); // one progress step each
 
-	data->sample = al_load_sample(GetDataFilePath(game, "boom.flac"));
-	data->sample_instance = al_create_sample_instance(data->sample);
-	al_attach_sample_instance_to_mixer(data->sample_instance, game->audio.fx);
+	PlayMusic(game, "music1.flac", 0);
 
 
-	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/0.flac"), 4, 1024),
+	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "0"),
 	                                                 "A crazy scientist from the future"), "speak");
-	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/1.flac"), 4, 1024),
+	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "1"),
 	                                                 "built a time machine"), "speak");
-	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/2.flac"), 4, 1024),
+	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "2"),
 	                                                 "and he went back in time."), "speak");
 
 	TM_AddDelay(data->timeline, 500);
 	TM_AddAction(data->timeline, TimeTravel, TM_AddToArgs(NULL, 1, data), "timetravel");
 	TM_AddDelay(data->timeline, 1500);
 
-	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/3.flac"), 4, 1024),
+	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "3"),
 	                                                 "Unfortunately, his time machine broke!"), "speak");
-	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/4a.flac"), 4, 1024),
+	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "4a"),
 	                                                 "Oh oh!"), "speak");
-	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/4b.flac"), 4, 1024),
+	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "4b"),
 	                                                 "- said crazy scientist"), "speak");
 
 	//---------------
@@ -225,13 +205,13 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 	TM_AddDelay(data->timeline, 250);
 	TM_AddQueuedBackgroundAction(data->timeline, Rotate, TM_AddToArgs(NULL, 1, data), 0, "rotate");
 
-	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/5.flac"), 4, 1024),
+	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "5"),
 	                                                 "Now he got some pieces of ancient technology"), "speak");
-	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/6.flac"), 4, 1024),
+	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "6"),
 	                                                 "and he's trying to fix his time machine."), "speak");
-	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/7.flac"), 4, 1024),
+	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "7"),
 	                                                 "I need all of these working together!"), "speak");
-	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/8.flac"), 4, 1024),
+	TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "8"),
 	                                                 "- said crazy scientist"), "speak");
 //		TM_AddAction(data->timeline, StartOthers, TM_AddToArgs(NULL, 1, data), "start");
 TM_AddAction(data->timeline, Finish, TM_AddToArgs(NULL, 1, data), "finish");
@@ -242,16 +222,13 @@ TM_AddAction(data->timeline, Finish, TM_AddToArgs(NULL, 1, data), "finish");
 void Gamestate_Unload(struct Game *game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_bitmap(data->bg);
-	al_destroy_bitmap(data->sos);
-	al_destroy_bitmap(data->machine);
-	al_destroy_bitmap(data->bird);
-	al_destroy_sample_instance(data->music);
-	al_destroy_sample_instance(data->music2);
-	al_destroy_sample_instance(data->sample_instance);
-	al_destroy_sample(data->music_sample);
-	al_destroy_sample(data->music2_sample);
-	al_destroy_sample(data->sample);
+	ReleaseResource(game, data->bg);
+	ReleaseResource(game, data->sos);
+	ReleaseResource(game, data->machine);
+	ReleaseResource(game, data->bird);
+	StopMusic(game);
+	StopFx(game, &data->boom);
+	ReleaseResource(game, data->boom.sample);
 	TM_Destroy(data->timeline);
 	free(data);
 }
@@ -25,21 +25,41 @@
 /*! \brief Resources used by Loading state. */
 struct LoadingResources {
 		ALLEGRO_BITMAP *bg;
+		double start; // when the screen went up
+		double last_flip;
+		double frame_time; // one display refresh
+		double min_time; // shortest time the screen stays visible
 };
 
-void Draw(struct Game *game, struct LoadingResources *data, float p) {
-	if ((p != 0.0) && (p != 1.0)) {
-		al_draw_bitmap(data->bg,0,0,0);
-//		SetupViewport(game, game->viewport_config);
-		al_flip_display();
-		            al_draw_bitmap(data->bg,0,0,0);
-		al_rest(0.2);
-	} else {
+static void Present(struct Game *game, struct LoadingResources *data, bool black) {
+	if (black) {
 		al_clear_to_color(al_map_rgb(0,0,0));
-//		SetupViewport(game, game->viewport_config);
-		al_flip_display();
-		al_rest(0.5);
-		            al_clear_to_color(al_map_rgb(0,0,0));
+	} else {
+		al_draw_bitmap(data->bg,0,0,0);
+	}
+	al_flip_display();
+	data->last_flip = al_get_time();
+}
+
+void Draw(struct Game *game, struct LoadingResources *data, float p) {
+	// Called on every progress step. Loading isn't held up here anymore:
+	// a new frame is only presented once a display refresh has passed,
+	// and the only deliberate wait is keeping the screen up for min_time.
+	double now = al_get_time();
+	if (p == 0.0) {
+		data->start = now;
+		Present(game, data, true);
+	} else if (p == 1.0) {
+		// The game takes over as soon as this returns, so a screen that was up
+		// too briefly is presented once more and held for the rest of min_time.
+		double remaining = data->min_time - (now - data->start);
+		if (remaining > 0) {
+			Present(game, data, false);
+			al_rest(remaining);
+		}
+		Present(game, data, true);
+	} else if (now - data->last_flip >= data->frame_time) {
+		Present(game, data, false);
 	}
 }
 
@@ -48,6 +68,11 @@ void* Load(struct Game *game) {
 
 	data->bg = al_load_bitmap(GetDataFilePath(game, "loading.png"));
 
+	int refresh = al_get_display_refresh_rate(game->display);
+	data->frame_time = 1.0 / ((refresh > 0) ? refresh : 60);
+	data->min_time = strtod(GetConfigOptionDefault(game, "DrSauce", "loading_min_time", "0.3"), NULL);
+	data->start = data->last_flip = 0;
+
 	return data;
 }
 void Unload(struct Game *game, struct LoadingResources *data) {
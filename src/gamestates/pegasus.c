@@ -29,23 +29,27 @@ struct GamestateResources {
 		struct Character *pegasus;
 		struct Character *tv;
 		struct Character *cartridge;
-		struct Character *cursor;
 		struct Timeline *timeline;
 		bool broken;
 		bool blowing;
 		int timer;
-		ALLEGRO_SAMPLE *sample;
-		ALLEGRO_SAMPLE_INSTANCE *sample_instance;
+		struct FxSound blow;
 
 };
 
-int Gamestate_ProgressCount = 1; // number of loading steps as reported by Gamestate_Load
+struct PanelState {
+		// Everything Gamestate_Draw depends on; the panel is re-rendered only when it changes.
+		struct CharacterState pegasus, tv, cartridge;
+		bool blowing;
+};
+
+int Gamestate_ProgressCount = 3; // number of loading steps as reported by Gamestate_Load
 
 void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 	// Called 60 times per second. Here you should do all your game logic.
 	TM_Process(data->timeline);
-	SetCharacterPosition(game, data->cursor, game->data->mousex, game->data->mousey, 0);
 	AnimateCharacter(game, data->tv, 1);
+	game->data->cursor.enabled[1] = !data->blowing;
 	data->timer--;
 
 	if (data->timer == 0) {
@@ -61,19 +65,28 @@ void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 void Gamestate_Draw(struct Game *game, struct GamestateResources* data) {
 	// Called as soon as possible, but no sooner than next Gamestate_Logic call.
 	// Draw everything to the screen here.
-	al_set_target_bitmap(game->data->pegasus);
-	al_clear_to_color(al_map_rgba(0,0,0,0));
-	al_draw_bitmap(data->tvbox, 502-320, 46, 0);
-	DrawCharacter(game, data->pegasus, al_map_rgb(255,255,255), 0);
-	DrawCharacter(game, data->tv, al_map_rgb(255,255,255), 0);
-	if (data->blowing) {
-		DrawCharacter(game, data->cartridge, al_map_rgb(255,255,255), 0);
+	struct PanelState state;
+	memset(&state, 0, sizeof(state));
+	GetCharacterState(data->pegasus, &state.pegasus);
+	GetCharacterState(data->tv, &state.tv);
+	state.blowing = data->blowing;
+	if (state.blowing) {
+		GetCharacterState(data->cartridge, &state.cartridge);
+	}
+	if (!BeginPanelDraw(game, 1, game->data->pegasus, &state, sizeof(state))) {
+		return;
 	}
-	if (game->data->mouse_visible && !data->blowing) {
-		DrawCharacter(game, data->cursor, al_map_rgb(255,255,255), 0);
+	BeginBatch(game, 1);
+
+	DrawBatchedBitmap(game, data->tvbox, 502-320, 46, 0);
+	DrawBatchedCharacter(game, data->pegasus, al_map_rgb(255,255,255), 0);
+	DrawBatchedCharacter(game, data->tv, al_map_rgb(255,255,255), 0);
+	if (state.blowing) {
+		DrawBatchedCharacter(game, data->cartridge, al_map_rgb(255,255,255), 0);
 	}
 
-	al_set_target_backbuffer(game->display);
+	EndBatch(game);
+	SetFrameTarget(game);
 }
 
 bool FixCartridge(struct Game *game, struct TM_Action *action, enum TM_ActionState state) {
@@ -131,7 +144,7 @@ void Gamestate_ProcessEvent(struct Game *game, struct GamestateResources* data,
 			SelectSpritesheet(game, data->tv, "empty");
 			SelectSpritesheet(game, data->pegasus, "empty");
 			data->blowing = true;
-			al_play_sample_instance(data->sample_instance);
+			PlayFx(game, &data->blow);
 
 			//game->data->status.pegasus = false;
 
@@ -149,35 +162,31 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 	struct GamestateResources *data = malloc(sizeof(struct GamestateResources));
 	progress(game); // report that we progressed with the loading, so the engine can draw a progress bar
 
-	data->tvbox = al_load_bitmap(GetDataFilePath(game, "tv.png"));
+	data->blow = (struct FxSound){.polyphony = 1, .priority = FX_PRIORITY_LOW};
+	struct Asset assets[] = {
+		{RESOURCE_BITMAP, "tv.png", &data->tvbox},
+		{RESOURCE_SAMPLE, "blow.flac", &data->blow.sample},
+	};
+	QueueAssets(game, assets, sizeof(assets) / sizeof(assets[0]), progress); // decoded while the intro plays
 
 	data->pegasus = CreateCharacter(game, "pegasus");
-	RegisterSpritesheet(game, data->pegasus, "full");
-	RegisterSpritesheet(game, data->pegasus, "empty");
-	LoadSpritesheets(game, data->pegasus);
+	RegisterCharacterSpritesheet(game, data->pegasus, "full");
+	RegisterCharacterSpritesheet(game, data->pegasus, "empty");
+	LoadCharacterSpritesheets(game, data->pegasus);
 	SelectSpritesheet(game, data->pegasus, "full");
 
 	data->tv = CreateCharacter(game, "tv");
-	RegisterSpritesheet(game, data->tv, "working");
-	RegisterSpritesheet(game, data->tv, "empty");
-	RegisterSpritesheet(game, data->tv, "broken");
-	LoadSpritesheets(game, data->tv);
+	RegisterCharacterSpritesheet(game, data->tv, "working");
+	RegisterCharacterSpritesheet(game, data->tv, "empty");
+	RegisterCharacterSpritesheet(game, data->tv, "broken");
+	LoadCharacterSpritesheets(game, data->tv);
 	SelectSpritesheet(game, data->tv, "working");
 
 	data->cartridge = CreateCharacter(game, "cartridge");
-	RegisterSpritesheet(game, data->cartridge, "blow");
-	LoadSpritesheets(game, data->cartridge);
+	RegisterCharacterSpritesheet(game, data->cartridge, "blow");
+	LoadCharacterSpritesheets(game, data->cartridge);
 	SelectSpritesheet(game, data->cartridge, "blow");
 
-	data->cursor = CreateCharacter(game, "cursor");
-	RegisterSpritesheet(game, data->cursor, "pointer");
-	LoadSpritesheets(game, data->cursor);
-	SelectSpritesheet(game, data->cursor, "pointer");
-
-	data->sample = al_load_sample(GetDataFilePath(game, "blow.flac"));
-	data->sample_instance = al_create_sample_instance(data->sample);
-	al_attach_sample_instance_to_mixer(data->sample_instance, game->audio.fx);
-
 	data->timeline = TM_Init(game, "pegasus");
 
 	return data;
@@ -186,13 +195,13 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game *game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_bitmap(data->tvbox);
+	WaitForAssets(game); // nothing may still be on its way into data
+	ReleaseResource(game, data->tvbox);
 	DestroyCharacter(game, data->pegasus);
 	DestroyCharacter(game, data->tv);
 	DestroyCharacter(game, data->cartridge);
-	DestroyCharacter(game, data->cursor);
-	al_destroy_sample_instance(data->sample_instance);
-	al_destroy_sample(data->sample);
+	StopFx(game, &data->blow);
+	ReleaseResource(game, data->blow.sample);
 	TM_Destroy(data->timeline);
 	free(data);
 }
@@ -210,6 +219,7 @@ void Gamestate_Start(struct Game *game, struct GamestateResources* data) {
 
 void Gamestate_Stop(struct Game *game, struct GamestateResources* data) {
 	// Called when gamestate gets stopped. Stop timers, music etc. here.
+	game->data->cursor.enabled[1] = false;
 }
 
 void Gamestate_Pause(struct Game *game, struct GamestateResources* data) {
@@ -25,7 +25,8 @@
 struct GamestateResources {
 		// This struct is for every resource allocated and used by your gamestate.
 		// It gets created on load and then gets passed around to all other function calls.
-		ALLEGRO_BITMAP *bg, *stage;
+		// Left empty: panels render straight into game->data->strip and the
+		// scroll position lives in game->data->offset.
 };
 
 int Gamestate_ProgressCount = 1; // number of loading steps as reported by Gamestate_Load
@@ -72,16 +73,23 @@ void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 void Gamestate_Draw(struct Game *game, struct GamestateResources* data) {
 	// Called as soon as possible, but no sooner than next Gamestate_Logic call.
 	// Draw everything to the screen here.
-	al_set_target_bitmap(data->stage);
-	al_draw_bitmap(data->bg, 0, 0, 0);
-	al_draw_bitmap(game->data->atari, 0, 0, 0);
-	al_draw_bitmap(game->data->pegasus, 320, 0, 0);
-	al_draw_bitmap(game->data->tape, 320*2, 0, 0);
-	al_draw_bitmap(game->data->floppy, 320*3, 0, 0);
-
-	al_set_target_backbuffer(game->display);
-	al_draw_bitmap(data->stage, -game->data->offset, 0, 0);
-	al_draw_bitmap(data->stage, -game->data->offset+4*320, 0, 0);
+	if (!BeginComposition(game)) {
+		return;
+	}
+	SetFrameTarget(game);
+	if (game->data->culling) {
+		// Blit only the slots of the strip that intersect the viewport.
+		int i;
+		for (i = 0; i < 4; i++) {
+			if (!IsScreenVisible(game, i)) {
+				continue;
+			}
+			al_draw_bitmap_region(game->data->strip, i*320, 0, 320, 180, GetScreenX(game, i), 0, 0);
+		}
+	} else {
+		al_draw_bitmap(game->data->strip, -game->data->offset, 0, 0);
+		al_draw_bitmap(game->data->strip, -game->data->offset+4*320, 0, 0);
+	}
 }
 
 void Gamestate_ProcessEvent(struct Game *game, struct GamestateResources* data, ALLEGRO_EVENT *ev) {
@@ -97,8 +105,6 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 	// Called once, when the gamestate library is being loaded.
 	// Good place for allocating memory, loading bitmaps etc.
 	struct GamestateResources *data = malloc(sizeof(struct GamestateResources));
-	data->bg = al_load_bitmap(GetDataFilePath(game, "stage.png"));
-	data->stage = al_create_bitmap(320*4, 180);
 	progress(game); // report that we progressed with the loading, so the engine can draw a progress bar
 	return data;
 }
@@ -106,19 +112,19 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game *game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
-	al_destroy_bitmap(data->bg);
-	al_destroy_bitmap(data->stage);
 	free(data);
 }
 
 void Gamestate_Start(struct Game *game, struct GamestateResources* data) {
 	// Called when this gamestate gets control. Good place for initializing state,
 	// playing music etc.
-
+	game->data->stage_running = true;
+	RequestRedraw(game);
 }
 
 void Gamestate_Stop(struct Game *game, struct GamestateResources* data) {
 	// Called when gamestate gets stopped. Stop timers, music etc. here.
+	game->data->stage_running = false;
 }
 
 void Gamestate_Pause(struct Game *game, struct GamestateResources* data) {
@@ -28,25 +28,27 @@ struct GamestateResources {
 		// It gets created on load and then gets passed around to all other function calls.
 		struct Character *tape;
 		struct Character *drive;
-		struct Character *cursor;
 		struct Character *timemachine;
 		struct Character *status;
 		int charge;
 		bool full;
-		ALLEGRO_SAMPLE *sample;
-		ALLEGRO_SAMPLE_INSTANCE *sample_instance;
-		ALLEGRO_SAMPLE *sample2;
-		ALLEGRO_SAMPLE_INSTANCE *sample_instance2;
+		struct FxSound boom;
+		struct FxSound win;
 		struct Timeline *timeline;
 };
 
-int Gamestate_ProgressCount = 1; // number of loading steps as reported by Gamestate_Load
+struct PanelState {
+		// Everything Gamestate_Draw depends on; the panel is re-rendered only when it changes.
+		struct CharacterState drive, status, timemachine;
+};
+
+int Gamestate_ProgressCount = 3; // number of loading steps as reported by Gamestate_Load
 
 void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 	// Called 60 times per second. Here you should do all your game logic.
 	AnimateCharacter(game, data->status, 1);
 	AnimateCharacter(game, data->timemachine, 1);
-	SetCharacterPosition(game, data->cursor, game->data->mousex, game->data->mousey, 0);
+	game->data->cursor.enabled[2] = true;
 	TM_Process(data->timeline);
 
 	if (game->data->charge < 10000) {
@@ -93,45 +95,41 @@ void Gamestate_Logic(struct Game *game, struct GamestateResources* data) {
 void Gamestate_Draw(struct Game *game, struct GamestateResources* data) {
 	// Called as soon as possible, but no sooner than next Gamestate_Logic call.
 	// Draw everything to the screen here.
-	al_set_target_bitmap(game->data->tape);
-	al_clear_to_color(al_map_rgba(0,0,0,0));
-	DrawCharacter(game, data->drive, al_map_rgb(255,255,255), 0);
-	DrawCharacter(game, data->status, al_map_rgb(255,255,255), 0);
-	DrawCharacter(game, data->timemachine, al_map_rgb(255,255,255), 0);
-
-	if (game->data->mouse_visible) {
-		DrawCharacter(game, data->cursor, al_map_rgb(255,255,255), 0);
+	struct PanelState state;
+	memset(&state, 0, sizeof(state));
+	GetCharacterState(data->drive, &state.drive);
+	GetCharacterState(data->status, &state.status);
+	GetCharacterState(data->timemachine, &state.timemachine);
+	if (!BeginPanelDraw(game, 2, game->data->tape, &state, sizeof(state))) {
+		return;
 	}
+	BeginBatch(game, 2);
+
+	DrawBatchedCharacter(game, data->drive, al_map_rgb(255,255,255), 0);
+	DrawBatchedCharacter(game, data->status, al_map_rgb(255,255,255), 0);
+	DrawBatchedCharacter(game, data->timemachine, al_map_rgb(255,255,255), 0);
 //	DrawCharacter(game, data->tape, al_map_rgb(255,255,255), 0);
-	al_set_target_backbuffer(game->display);
+	EndBatch(game);
+	SetFrameTarget(game);
 }
 
 bool Speak(struct Game *game, struct TM_Action *action, enum TM_ActionState state) {
 //	struct GamestateResources *data = TM_GetArg(action->arguments, 0);
-	ALLEGRO_AUDIO_STREAM *stream = TM_GetArg(action->arguments, 1);
+	struct VoiceLine *line = TM_GetArg(action->arguments, 1);
 	char *text = TM_GetArg(action->arguments, 2);
 
-	if (state == TM_ACTIONSTATE_INIT) {
-		al_set_audio_stream_playing(stream, false);
-		al_set_audio_stream_playmode(stream, ALLEGRO_PLAYMODE_ONCE);
-	}
-
 	if (state == TM_ACTIONSTATE_START) {
 		if (game->data->won) return true;
 		game->data->skip = false;
-		//al_rewind_audio_stream(stream);
-		al_attach_audio_stream_to_mixer(stream, game->audio.voice);
-		al_set_audio_stream_playing(stream, true);
-
-		game->data->text = text;
+		StartVoiceLine(game, line, text); // opened only now
 	}
 
 	if (state == TM_ACTIONSTATE_RUNNING) {
-		return !al_get_audio_stream_playing(stream) || game->data->skip;
+		return IsVoiceLineFinished(line) || game->data->skip;
 	}
 
 	if (state == TM_ACTIONSTATE_DESTROY) {
-		al_destroy_audio_stream(stream);
+		DestroyVoiceLine(game, line);
 		if (!game->data->won) {
 			game->data->text = NULL;
 		}
@@ -172,8 +170,8 @@ void Gamestate_ProcessEvent(struct Game *game, struct GamestateResources* data,
 	if ((ev->type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN) && (game->data->mouse_visible)) {
 		if (IsOnCharacter(game, data->timemachine, game->data->mousex, game->data->mousey)) {
 			if (game->data->charge == 10000) {
-				al_play_sample_instance(data->sample_instance);
-				al_play_sample_instance(data->sample_instance2);
+				PlayFx(game, &data->boom);
+				PlayFx(game, &data->win);
 				SelectSpritesheet(game, data->timemachine, "blank");
 				game->data->text = malloc(255*sizeof(char));
 
@@ -184,9 +182,9 @@ void Gamestate_ProcessEvent(struct Game *game, struct GamestateResources* data,
 				game->data->mouse_visible = false;
 			} else {
 				if (!game->data->text) {
-					TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/machine1.flac"), 4, 1024),
+					TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "machine1"),
 					                                                 "The machine is not ready yet!"), "speak");
-					TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, al_load_audio_stream(GetDataFilePath(game, "voice/machine2.flac"), 4, 1024),
+					TM_AddAction(data->timeline, Speak, TM_AddToArgs(NULL, 3, data, CreateVoiceLine(game, "machine2"),
 					                                                 "- said the scientist"), "speak");
 				}
 			}
@@ -202,66 +200,62 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 	progress(game); // report that we progressed with the loading, so the engine can draw a progress bar
 
 	data->drive = CreateCharacter(game, "drive");
-	RegisterSpritesheet(game, data->drive, "working");
-	LoadSpritesheets(game, data->drive);
+	RegisterCharacterSpritesheet(game, data->drive, "working");
+	LoadCharacterSpritesheets(game, data->drive);
 	SelectSpritesheet(game, data->drive, "working");
 
 	data->tape = CreateCharacter(game, "tape");
-	RegisterSpritesheet(game, data->tape, "fixing");
-	LoadSpritesheets(game, data->tape);
+	RegisterCharacterSpritesheet(game, data->tape, "fixing");
+	LoadCharacterSpritesheets(game, data->tape);
 	SelectSpritesheet(game, data->tape, "fixing");
 
 	data->status = CreateCharacter(game, "status");
-	RegisterSpritesheet(game, data->status, "0000");
-	RegisterSpritesheet(game, data->status, "0001");
-	RegisterSpritesheet(game, data->status, "0010");
-	RegisterSpritesheet(game, data->status, "0011");
-	RegisterSpritesheet(game, data->status, "0100");
-	RegisterSpritesheet(game, data->status, "0101");
-	RegisterSpritesheet(game, data->status, "0110");
-	RegisterSpritesheet(game, data->status, "0111");
-	RegisterSpritesheet(game, data->status, "1000");
-	RegisterSpritesheet(game, data->status, "1001");
-	RegisterSpritesheet(game, data->status, "1010");
-	RegisterSpritesheet(game, data->status, "1011");
-	RegisterSpritesheet(game, data->status, "1100");
-	RegisterSpritesheet(game, data->status, "1101");
-	RegisterSpritesheet(game, data->status, "1110");
-	RegisterSpritesheet(game, data->status, "1111");
-	LoadSpritesheets(game, data->status);
+	RegisterCharacterSpritesheet(game, data->status, "0000");
+	RegisterCharacterSpritesheet(game, data->status, "0001");
+	RegisterCharacterSpritesheet(game, data->status, "0010");
+	RegisterCharacterSpritesheet(game, data->status, "0011");
+	RegisterCharacterSpritesheet(game, data->status, "0100");
+	RegisterCharacterSpritesheet(game, data->status, "0101");
+	RegisterCharacterSpritesheet(game, data->status, "0110");
+	RegisterCharacterSpritesheet(game, data->status, "0111");
+	RegisterCharacterSpritesheet(game, data->status, "1000");
+	RegisterCharacterSpritesheet(game, data->status, "1001");
+	RegisterCharacterSpritesheet(game, data->status, "1010");
+	RegisterCharacterSpritesheet(game, data->status, "1011");
+	RegisterCharacterSpritesheet(game, data->status, "1100");
+	RegisterCharacterSpritesheet(game, data->status, "1101");
+	RegisterCharacterSpritesheet(game, data->status, "1110");
+	RegisterCharacterSpritesheet(game, data->status, "1111");
+	LoadCharacterSpritesheets(game, data->status);
 	SelectSpritesheet(game, data->status, "1111");
 
 	data->timeline = TM_Init(game, "tape");
 
-	data->cursor = CreateCharacter(game, "cursor");
-	RegisterSpritesheet(game, data->cursor, "pointer");
-	LoadSpritesheets(game, data->cursor);
-	SelectSpritesheet(game, data->cursor, "pointer");
-
 
 	data->timemachine = CreateCharacter(game, "timemachine");
-	RegisterSpritesheet(game, data->timemachine, "charging");
-	RegisterSpritesheet(game, data->timemachine, "charging0");
-	RegisterSpritesheet(game, data->timemachine, "charging1");
-	RegisterSpritesheet(game, data->timemachine, "charging2");
-	RegisterSpritesheet(game, data->timemachine, "charging3");
-	RegisterSpritesheet(game, data->timemachine, "charging4");
-	RegisterSpritesheet(game, data->timemachine, "charging5");
-	RegisterSpritesheet(game, data->timemachine, "charging6");
-	RegisterSpritesheet(game, data->timemachine, "charging7");
-	RegisterSpritesheet(game, data->timemachine, "charging8");
-	RegisterSpritesheet(game, data->timemachine, "charging9");
-	RegisterSpritesheet(game, data->timemachine, "full");
-	RegisterSpritesheet(game, data->timemachine, "blank");
-	LoadSpritesheets(game, data->timemachine);
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging");
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging0");
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging1");
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging2");
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging3");
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging4");
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging5");
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging6");
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging7");
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging8");
+	RegisterCharacterSpritesheet(game, data->timemachine, "charging9");
+	RegisterCharacterSpritesheet(game, data->timemachine, "full");
+	RegisterCharacterSpritesheet(game, data->timemachine, "blank");
+	LoadCharacterSpritesheets(game, data->timemachine);
 	SelectSpritesheet(game, data->timemachine, "charging0");
 
-	data->sample = al_load_sample(GetDataFilePath(game, "boom.flac"));
-	data->sample_instance = al_create_sample_instance(data->sample);
-	al_attach_sample_instance_to_mixer(data->sample_instance, game->audio.fx);
-	data->sample2 = al_load_sample(GetDataFilePath(game, "win.flac"));
-	data->sample_instance2 = al_create_sample_instance(data->sample2);
-	al_attach_sample_instance_to_mixer(data->sample_instance2, game->audio.fx);
+	data->boom = (struct FxSound){.polyphony = 1, .priority = FX_PRIORITY_HIGH};
+	data->win = (struct FxSound){.polyphony = 1, .priority = FX_PRIORITY_HIGH};
+	struct Asset assets[] = {
+		{RESOURCE_SAMPLE, "boom.flac", &data->boom.sample},
+		{RESOURCE_SAMPLE, "win.flac", &data->win.sample},
+	};
+	QueueAssets(game, assets, sizeof(assets) / sizeof(assets[0]), progress); // decoded while the intro plays
 
 	return data;
 }
@@ -269,15 +263,15 @@ void* Gamestate_Load(struct Game *game, void (*progress)(struct Game*)) {
 void Gamestate_Unload(struct Game *game, struct GamestateResources* data) {
 	// Called when the gamestate library is being unloaded.
 	// Good place for freeing all allocated memory and resources.
+	WaitForAssets(game); // nothing may still be on its way into data
 	DestroyCharacter(game, data->status);
 	DestroyCharacter(game, data->timemachine);
 	DestroyCharacter(game, data->tape);
 	DestroyCharacter(game, data->drive);
-	DestroyCharacter(game, data->cursor);
-	al_destroy_sample_instance(data->sample_instance);
-	al_destroy_sample(data->sample);
-	al_destroy_sample_instance(data->sample_instance2);
-	al_destroy_sample(data->sample2);
+	StopFx(game, &data->boom);
+	ReleaseResource(game, data->boom.sample);
+	StopFx(game, &data->win);
+	ReleaseResource(game, data->win.sample);
 	TM_Destroy(data->timeline);
 	free(data);
 	if (game->data->won) {
@@ -299,6 +293,7 @@ void Gamestate_Start(struct Game *game, struct GamestateResources* data) {
 
 void Gamestate_Stop(struct Game *game, struct GamestateResources* data) {
 	// Called when gamestate gets stopped. Stop timers, music etc. here.
+	game->data->cursor.enabled[2] = false;
 }
 
 void Gamestate_Pause(struct Game *game, struct GamestateResources* data) {
@@ -0,0 +1,311 @@
+/*! \file loader.c
+ *  \brief Decoding assets in parallel while a gamestate loads.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+// PNG and FLAC decoding happens on a few worker threads, into memory
+// bitmaps and sample buffers. Uploading bitmaps to the GPU and putting
+// everything into the resource cache is left to the calling (display)
+// thread, which reports progress as each asset comes in.
+//
+// LoadAssets waits for its batch right away. QueueAssets hands the batch
+// to a queue that keeps decoding in the background while the game runs;
+// PumpAssets moves finished assets into place a few at a time and
+// WaitForAssets blocks on whatever is left.
+
+#define LOADER_THREADS 4
+#define PUMP_BUDGET 0.004 // seconds PumpAssets may spend uploading per call
+
+struct LoadJob {
+		struct Asset asset; // copied, the caller's array may be long gone when it's done
+		const void *contents; // within the data archive, if it's there
+		size_t size;
+		const char *path; // otherwise resolved up front, ResolveDataPath isn't thread safe
+		void *object; // decoded by a worker
+		bool done, finished;
+};
+
+struct Loader {
+		struct LoadJob **jobs;
+		int count, capacity, next, finished;
+		struct Game *game;
+		int bitmap_flags;
+		bool quit; // workers leave once there's nothing left to take
+		ALLEGRO_MUTEX *mutex;
+		ALLEGRO_COND *cond;
+		ALLEGRO_THREAD *workers[LOADER_THREADS];
+		int threads;
+};
+
+static void* Worker(ALLEGRO_THREAD *thread, void *arg) {
+	struct Loader *loader = arg;
+	// new bitmap flags are per thread
+	al_set_new_bitmap_flags((loader->bitmap_flags & ~ALLEGRO_VIDEO_BITMAP) | ALLEGRO_MEMORY_BITMAP);
+	while (true) {
+		al_lock_mutex(loader->mutex);
+		while ((loader->next == loader->count) && !loader->quit) {
+			al_wait_cond(loader->cond, loader->mutex);
+		}
+		if (loader->next == loader->count) {
+			al_unlock_mutex(loader->mutex);
+			break;
+		}
+		struct LoadJob *job = loader->jobs[loader->next++];
+		al_unlock_mutex(loader->mutex);
+
+		void *object = NULL;
+		if (job->asset.type == RESOURCE_BITMAP) {
+			// goes through the texture cache
+			object = job->contents ? DecodeBitmap(loader->game, job->asset.filename, job->contents, job->size) : DecodeBitmapFile(loader->game, job->path);
+		} else if (job->asset.type == RESOURCE_SAMPLE) {
+			// and this through the sample cache
+			object = job->contents ? DecodeSample(loader->game, job->asset.filename, job->contents, job->size) : DecodeSampleFile(loader->game, job->path);
+		}
+
+		al_lock_mutex(loader->mutex);
+		job->object = object;
+		job->done = true;
+		al_broadcast_cond(loader->cond);
+		al_unlock_mutex(loader->mutex);
+	}
+	return NULL;
+}
+
+static struct Loader* CreateLoader(struct Game *game, bool persistent) {
+	struct Loader *loader = calloc(1, sizeof(struct Loader));
+	loader->game = game;
+	loader->bitmap_flags = al_get_new_bitmap_flags();
+	loader->quit = !persistent;
+	loader->mutex = al_create_mutex();
+	loader->cond = al_create_cond();
+	return loader;
+}
+
+static void AddJob(struct Game *game, struct Loader *loader, struct Asset *asset) {
+	struct LoadJob *job = calloc(1, sizeof(struct LoadJob));
+	job->asset = *asset;
+	job->contents = GetArchivedFile(game, asset->filename, &job->size);
+	if (!job->contents) {
+		job->path = ResolveDataPath(game, asset->filename);
+	}
+	al_lock_mutex(loader->mutex);
+	if (loader->count == loader->capacity) {
+		loader->capacity = loader->capacity ? loader->capacity * 2 : 8;
+		loader->jobs = realloc(loader->jobs, loader->capacity * sizeof(struct LoadJob*));
+	}
+	loader->jobs[loader->count++] = job;
+	al_broadcast_cond(loader->cond);
+	al_unlock_mutex(loader->mutex);
+}
+
+static void StartWorkers(struct Loader *loader) {
+	// One thread per waiting job, up to LOADER_THREADS. A loader that isn't
+	// persistent must have all its jobs added by now, as idle workers quit.
+	al_lock_mutex(loader->mutex);
+	while ((loader->threads < LOADER_THREADS) && (loader->threads < loader->count - loader->next)) {
+		loader->workers[loader->threads] = al_create_thread(Worker, loader);
+		al_start_thread(loader->workers[loader->threads]);
+		loader->threads++;
+	}
+	al_unlock_mutex(loader->mutex);
+}
+
+static void DestroyObject(struct Game *game, enum ResourceType type, void *object) {
+	if (type == RESOURCE_BITMAP) {
+		al_destroy_bitmap(object);
+	} else if (type == RESOURCE_SAMPLE) {
+		DestroySample(game, object);
+	}
+}
+
+static void FinishJob(struct Game *game, struct LoadJob *job) {
+	struct Asset *asset = &job->asset;
+	void *object = job->object;
+	void *cached = LookupResource(game, asset->type, asset->filename, asset->size, asset->flags);
+	if (cached) {
+		// asked for twice, and the other one got there first
+		if (object) {
+			DestroyObject(game, asset->type, object);
+		}
+		object = cached;
+	} else if (object) {
+		if (asset->type == RESOURCE_BITMAP) {
+			// upload; falls back to a memory bitmap if that's not possible
+			al_convert_bitmap(object);
+		}
+		AddResource(game, asset->type, asset->filename, asset->size, asset->flags, object);
+	} else {
+		// let the synchronous path deal with (and report) the failure
+		object = (asset->type == RESOURCE_BITMAP) ? (void*)AcquireBitmap(game, asset->filename) : (void*)AcquireSample(game, asset->filename);
+	}
+	*(void**)asset->target = object;
+}
+
+static bool FinishNext(struct Game *game, struct Loader *loader, bool wait) {
+	// Puts one decoded asset in place, if there's one (or, with wait, once
+	// there is). Returns false when there was nothing to finish.
+	struct LoadJob *job = NULL;
+	al_lock_mutex(loader->mutex);
+	while (loader->finished < loader->count) {
+		int i;
+		for (i = 0; i < loader->count; i++) {
+			if (loader->jobs[i]->done && !loader->jobs[i]->finished) {
+				job = loader->jobs[i];
+				break;
+			}
+		}
+		if (job || !wait) {
+			break;
+		}
+		al_wait_cond(loader->cond, loader->mutex);
+	}
+	if (job) {
+		job->finished = true;
+		loader->finished++;
+	}
+	al_unlock_mutex(loader->mutex);
+	if (job) {
+		FinishJob(game, job);
+	}
+	return job != NULL;
+}
+
+static void FreeJobs(struct Loader *loader) {
+	// Workers must not be able to take any of them anymore.
+	int i;
+	for (i = 0; i < loader->count; i++) {
+		if (loader->jobs[i]->done && !loader->jobs[i]->finished && loader->jobs[i]->object) {
+			DestroyObject(loader->game, loader->jobs[i]->asset.type, loader->jobs[i]->object);
+		}
+		free(loader->jobs[i]);
+	}
+	loader->count = loader->next = loader->finished = 0;
+}
+
+static void DestroyLoader(struct Loader *loader) {
+	al_lock_mutex(loader->mutex);
+	loader->quit = true;
+	loader->next = loader->count; // drop anything not taken yet
+	al_broadcast_cond(loader->cond);
+	al_unlock_mutex(loader->mutex);
+	int i;
+	for (i = 0; i < loader->threads; i++) {
+		al_join_thread(loader->workers[i], NULL);
+		al_destroy_thread(loader->workers[i]);
+	}
+	FreeJobs(loader);
+	free(loader->jobs);
+	al_destroy_cond(loader->cond);
+	al_destroy_mutex(loader->mutex);
+	free(loader);
+}
+
+static bool TakeResident(struct Game *game, struct Asset *asset) {
+	// Those already resident only get referenced. Fonts are created right away,
+	// as (prebaked or not) they need the display.
+	void *object = LookupResource(game, asset->type, asset->filename, asset->size, asset->flags);
+	if (!object && (asset->type == RESOURCE_FONT)) {
+		object = AcquireFont(game, asset->filename, asset->size, asset->flags);
+	}
+	*(void**)asset->target = object;
+	return object != NULL;
+}
+
+void LoadAssets(struct Game *game, struct Asset *assets, int count, void (*progress)(struct Game*)) {
+	// Loads every asset through the resource cache, calling progress once per asset.
+	struct Loader *loader = CreateLoader(game, false);
+	int i;
+	for (i = 0; i < count; i++) {
+		if (TakeResident(game, &assets[i])) {
+			progress(game);
+		} else {
+			AddJob(game, loader, &assets[i]);
+		}
+	}
+	StartWorkers(loader);
+	while (FinishNext(game, loader, true)) {
+		progress(game);
+	}
+	DestroyLoader(loader);
+}
+
+void QueueAssets(struct Game *game, struct Asset *assets, int count, void (*progress)(struct Game*)) {
+	// Like LoadAssets, but returns without waiting for the decoding. Targets stay
+	// NULL until PumpAssets or WaitForAssets puts the objects in. Progress is
+	// reported once per asset as it's queued.
+	if (!game->data->asset_queue) {
+		game->data->asset_queue = CreateLoader(game, true);
+	}
+	int i;
+	for (i = 0; i < count; i++) {
+		if (!TakeResident(game, &assets[i])) {
+			AddJob(game, game->data->asset_queue, &assets[i]);
+		}
+		progress(game);
+	}
+	StartWorkers(game->data->asset_queue);
+}
+
+static void TrimQueue(struct Loader *loader) {
+	// Forgets the jobs once all of them are in place; the workers stay around.
+	al_lock_mutex(loader->mutex);
+	if (loader->finished == loader->count) {
+		FreeJobs(loader);
+	}
+	al_unlock_mutex(loader->mutex);
+}
+
+void PumpAssets(struct Game *game) {
+	// Called every tick; puts what the workers have decoded so far in place,
+	// stopping after PUMP_BUDGET so GPU uploads don't cause a hitch.
+	struct Loader *loader = game->data->asset_queue;
+	if (!loader) {
+		return;
+	}
+	double start = al_get_time();
+	while ((al_get_time() - start < PUMP_BUDGET) && FinishNext(game, loader, false)) {}
+	TrimQueue(loader);
+}
+
+void WaitForAssets(struct Game *game) {
+	// Blocks until everything queued is in place.
+	struct Loader *loader = game->data->asset_queue;
+	if (!loader) {
+		return;
+	}
+	double start = al_get_time();
+	int count = 0;
+	while (FinishNext(game, loader, true)) {
+		count++;
+	}
+	if (count) {
+		PrintConsole(game, "Waited %.1f ms for %d queued assets", (al_get_time() - start) * 1000, count);
+	}
+	TrimQueue(loader);
+}
+
+void DestroyAssetQueue(struct Game *game) {
+	if (game->data->asset_queue) {
+		DestroyLoader(game->data->asset_queue);
+		game->data->asset_queue = NULL;
+	}
+}
@@ -0,0 +1,86 @@
+/*! \file music.c
+ *  \brief Streamed, crossfading background music.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+// Music tracks aren't decoded up front: each one plays as an audio stream
+// on the music mixer, decoded a buffer at a time as it goes. Streams loop
+// by rewinding inside the feeder, so the loop point has no gap. Switching
+// tracks fades the old one out while the new one fades in; the fade is
+// stepped from the HUD's logic, which runs for the whole game.
+
+#define MUSIC_BUFFERS 2
+#define MUSIC_BUFFER_SAMPLES 8192
+
+static void DestroyTrack(struct MusicTrack *track) {
+	if (track->stream) {
+		al_set_audio_stream_playing(track->stream, false);
+		al_destroy_audio_stream(track->stream);
+	}
+	track->stream = NULL;
+}
+
+static void SetTrackGain(struct MusicTrack *track, float gain) {
+	track->gain = gain;
+	al_set_audio_stream_gain(track->stream, gain);
+}
+
+void PlayMusic(struct Game *game, const char *filename, float fade) {
+	// Starts looping the track, crossfading from the current one over fade seconds.
+	struct CommonResources *data = game->data;
+	// a fade still in progress gets cut short
+	DestroyTrack(&data->music.previous);
+	data->music.previous = data->music.current;
+	data->music.current.stream = LoadDataAudioStream(game, filename, MUSIC_BUFFERS, MUSIC_BUFFER_SAMPLES);
+	if (!data->music.current.stream) {
+		PrintConsole(game, "Could not stream %s", filename);
+		return;
+	}
+	al_set_audio_stream_playmode(data->music.current.stream, ALLEGRO_PLAYMODE_LOOP);
+	al_attach_audio_stream_to_mixer(data->music.current.stream, game->audio.music);
+	data->music.step = (fade > 0) ? (1.0 / (fade * 60)) : 1.0;
+	SetTrackGain(&data->music.current, (fade > 0) ? 0.0 : 1.0);
+	if (fade <= 0) {
+		DestroyTrack(&data->music.previous);
+	}
+}
+
+void UpdateMusic(struct Game *game) {
+	// Called 60 times per second.
+	struct CommonResources *data = game->data;
+	if (data->music.current.stream && (data->music.current.gain < 1.0)) {
+		float gain = data->music.current.gain + data->music.step;
+		SetTrackGain(&data->music.current, (gain < 1.0) ? gain : 1.0);
+	}
+	if (data->music.previous.stream) {
+		if (data->music.previous.gain <= data->music.step) {
+			DestroyTrack(&data->music.previous);
+		} else {
+			SetTrackGain(&data->music.previous, data->music.previous.gain - data->music.step);
+		}
+	}
+}
+
+void StopMusic(struct Game *game) {
+	DestroyTrack(&game->data->music.current);
+	DestroyTrack(&game->data->music.previous);
+}
@@ -0,0 +1,212 @@
+/*! \file resources.c
+ *  \brief Reference-counted assets shared between gamestates.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+// Gamestates acquire assets by their data path (plus size and flags for
+// fonts) and release them when unloading. Everyone asking for the same
+// thing gets the same object; it's destroyed once the last user lets go.
+
+static struct Resource* FindResource(struct Game *game, enum ResourceType type, const char *filename, int size, int flags) {
+	struct Resource *resource;
+	for (resource = game->data->resources; resource; resource = resource->next) {
+		if ((resource->type == type) && (resource->size == size) && (resource->flags == flags) &&
+		    !strcmp(resource->filename, filename)) {
+			return resource;
+		}
+	}
+	return NULL;
+}
+
+ALLEGRO_FONT* LoadFont(struct Game *game, const char *filename, int size, int flags) {
+	// Uses the bitmap font prebaked at build time (fonts/<name>-<size>.png) when
+	// there is one, skipping FreeType rasterization entirely.
+#ifdef DRSAUCE_PREBAKED_FONTS
+	if (!flags) {
+		ALLEGRO_PATH *baked = al_create_path(filename);
+		char name[255];
+		snprintf(name, 255, "%s-%d", al_get_path_basename(baked), size);
+		al_set_path_filename(baked, name);
+		al_set_path_extension(baked, ".png");
+		const char *bakedname = al_path_cstr(baked, '/');
+		ALLEGRO_FONT *font = NULL;
+		size_t length;
+		ALLEGRO_BITMAP *bitmap = NULL;
+		if (GetArchivedFile(game, bakedname, &length)) {
+			bitmap = LoadDataBitmap(game, bakedname);
+		} else if (FindDataPath(game, bakedname)) {
+			// not archived; it's in the build tree or installed next to the TTF
+			bitmap = DecodeBitmapFile(game, FindDataPath(game, bakedname));
+		}
+		if (bitmap) {
+			int ranges[] = {32, 126};
+			font = al_grab_font_from_bitmap(bitmap, 1, ranges);
+			al_destroy_bitmap(bitmap);
+		}
+		al_destroy_path(baked);
+		if (font) {
+			return font;
+		}
+	}
+#endif
+	return LoadDataTTF(game, filename, size, flags);
+}
+
+void* LookupResource(struct Game *game, enum ResourceType type, const char *filename, int size, int flags) {
+	// Takes a reference if it's already loaded, NULL otherwise.
+	struct Resource *resource = FindResource(game, type, filename, size, flags);
+	if (!resource) {
+		return NULL;
+	}
+	resource->refs++;
+	return resource->object;
+}
+
+void AddResource(struct Game *game, enum ResourceType type, const char *filename, int size, int flags, void *object) {
+	// Puts an object loaded elsewhere into the cache, holding one reference.
+	struct Resource *resource = calloc(1, sizeof(struct Resource));
+	resource->type = type;
+	resource->filename = strdup(filename);
+	resource->size = size;
+	resource->flags = flags;
+	resource->object = object;
+	resource->refs = 1;
+	resource->next = game->data->resources;
+	game->data->resources = resource;
+}
+
+static void* Acquire(struct Game *game, enum ResourceType type, const char *filename, int size, int flags) {
+	void *object = LookupResource(game, type, filename, size, flags);
+	if (object) {
+		return object;
+	}
+
+	switch (type) {
+		case RESOURCE_BITMAP:
+			object = LoadDataBitmap(game, filename);
+			break;
+		case RESOURCE_FONT:
+			object = LoadFont(game, filename, size, flags);
+			break;
+		case RESOURCE_SAMPLE:
+			object = LoadDataSample(game, filename);
+			break;
+	}
+	if (!object) {
+		PrintConsole(game, "Could not load %s", filename);
+		return NULL;
+	}
+
+	AddResource(game, type, filename, size, flags, object);
+	return object;
+}
+
+ALLEGRO_BITMAP* AcquireBitmap(struct Game *game, const char *filename) {
+	return Acquire(game, RESOURCE_BITMAP, filename, 0, 0);
+}
+
+ALLEGRO_FONT* AcquireFont(struct Game *game, const char *filename, int size, int flags) {
+	return Acquire(game, RESOURCE_FONT, filename, size, flags);
+}
+
+ALLEGRO_SAMPLE* AcquireSample(struct Game *game, const char *filename) {
+	return Acquire(game, RESOURCE_SAMPLE, filename, 0, 0);
+}
+
+static void DestroyResource(struct Game *game, struct Resource *resource) {
+	switch (resource->type) {
+		case RESOURCE_BITMAP:
+			al_destroy_bitmap(resource->object);
+			break;
+		case RESOURCE_FONT:
+			InvalidateTextCache(game, resource->object);
+			al_destroy_font(resource->object);
+			break;
+		case RESOURCE_SAMPLE:
+			// any sample instances using it must be gone by now
+			DestroySample(game, resource->object);
+			break;
+	}
+	free(resource->filename);
+	free(resource);
+}
+
+void ReleaseResource(struct Game *game, void *object) {
+	if (!object) {
+		return;
+	}
+	struct Resource **resource;
+	for (resource = &game->data->resources; *resource; resource = &(*resource)->next) {
+		if ((*resource)->object == object) {
+			if (!--(*resource)->refs) {
+				struct Resource *unused = *resource;
+				*resource = unused->next;
+				DestroyResource(game, unused);
+			}
+			return;
+		}
+	}
+	PrintConsole(game, "Releasing a resource that's not in the cache!");
+}
+
+static size_t GetResourceSize(struct Resource *resource) {
+	// Rough amount of memory held, for reporting.
+	switch (resource->type) {
+		case RESOURCE_BITMAP:
+			return al_get_bitmap_width(resource->object) * al_get_bitmap_height(resource->object) * 4;
+		case RESOURCE_SAMPLE:
+			return al_get_sample_length(resource->object) *
+			       al_get_channel_count(al_get_sample_channels(resource->object)) *
+			       al_get_audio_depth_size(al_get_sample_depth(resource->object));
+		default:
+			return 0;
+	}
+}
+
+void ReportResources(struct Game *game) {
+	static const char *types[] = {"bitmap", "font", "sample"};
+	struct Resource *resource;
+	size_t total = 0;
+	int count = 0;
+	PrintConsole(game, "Resident resources:");
+	for (resource = game->data->resources; resource; resource = resource->next) {
+		size_t size = GetResourceSize(resource);
+		if (resource->type == RESOURCE_FONT) {
+			PrintConsole(game, "  %s %s (%d) x%d", types[resource->type], resource->filename, resource->size, resource->refs);
+		} else {
+			PrintConsole(game, "  %s %s x%d, %zu kB", types[resource->type], resource->filename, resource->refs, size / 1024);
+		}
+		total += size;
+		count++;
+	}
+	PrintConsole(game, "%d resources, %zu kB", count, total / 1024);
+}
+
+void DestroyResources(struct Game *game) {
+	// Everything should have been released already; whatever wasn't gets freed anyway.
+	while (game->data->resources) {
+		struct Resource *resource = game->data->resources;
+		PrintConsole(game, "Resource %s was never released!", resource->filename);
+		game->data->resources = resource->next;
+		DestroyResource(game, resource);
+	}
+}
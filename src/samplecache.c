@@ -0,0 +1,280 @@
+/*! \file samplecache.c
+ *  \brief Sound effects converted to the mixer's format, cached across runs.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+#include <stdint.h>
+
+// FLAC effects are decoded on every launch, and unless they happen to
+// match the fx mixer, converted again on every playback. So the first
+// time a sample is loaded, it's converted to the mixer's frequency,
+// depth and channel layout and written to the user's cache directory as
+// raw PCM. After that it's mapped and handed to Allegro as it is: no
+// decoding, and nothing for the mixer to convert. Entries are named after
+// a hash of the source file and the mixer's format, so a changed file or
+// a different audio setup simply makes new ones.
+
+#define SAMPLE_CACHE_MAGIC "DSPC"
+#define SAMPLE_CACHE_VERSION 1
+
+struct SampleCacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t hash; // of the source file
+		uint64_t size; // of the source file
+		uint32_t frequency, depth, channels; // ALLEGRO_AUDIO_DEPTH and ALLEGRO_CHANNEL_CONF
+		uint32_t length; // in frames
+		// followed by the interleaved PCM
+};
+
+struct SampleMapping {
+		ALLEGRO_SAMPLE *sample;
+		void *file;
+		size_t size;
+		struct SampleMapping *next;
+};
+
+void OpenSampleCache(struct Game *game, struct CommonResources *data) {
+	if (!atoi(GetConfigOptionDefault(game, "DrSauce", "sample_cache", "1"))) {
+		return;
+	}
+	data->sample_cache.frequency = al_get_mixer_frequency(game->audio.fx);
+	data->sample_cache.channels = al_get_mixer_channels(game->audio.fx);
+	data->sample_cache.depth = al_get_mixer_depth(game->audio.fx);
+	if ((data->sample_cache.depth != ALLEGRO_AUDIO_DEPTH_FLOAT32) && (data->sample_cache.depth != ALLEGRO_AUDIO_DEPTH_INT16)) {
+		PrintConsole(game, "Unexpected mixer depth, not caching samples");
+		return;
+	}
+	data->sample_cache.dir = CreateCacheDirectory(game, "samples");
+	data->sample_cache.mutex = al_create_mutex();
+}
+
+void CloseSampleCache(struct Game *game) {
+	// Samples using the mappings have to be gone by now.
+	while (game->data->sample_cache.mappings) {
+		struct SampleMapping *mapping = game->data->sample_cache.mappings;
+		game->data->sample_cache.mappings = mapping->next;
+		UnmapFile(mapping->file, mapping->size);
+		free(mapping);
+	}
+	if (game->data->sample_cache.mutex) {
+		al_destroy_mutex(game->data->sample_cache.mutex);
+	}
+	free(game->data->sample_cache.dir);
+	game->data->sample_cache.dir = NULL;
+	game->data->sample_cache.mutex = NULL;
+}
+
+static float ReadValue(const void *data, ALLEGRO_AUDIO_DEPTH depth, size_t i) {
+	switch (depth) {
+		case ALLEGRO_AUDIO_DEPTH_INT8:
+			return ((const int8_t*)data)[i] / 128.0f;
+		case ALLEGRO_AUDIO_DEPTH_UINT8:
+			return (((const uint8_t*)data)[i] - 128) / 128.0f;
+		case ALLEGRO_AUDIO_DEPTH_INT16:
+			return ((const int16_t*)data)[i] / 32768.0f;
+		case ALLEGRO_AUDIO_DEPTH_UINT16:
+			return (((const uint16_t*)data)[i] - 32768) / 32768.0f;
+		case ALLEGRO_AUDIO_DEPTH_INT24:
+			return ((const int32_t*)data)[i] / 8388608.0f;
+		case ALLEGRO_AUDIO_DEPTH_UINT24:
+			return ((int32_t)((const uint32_t*)data)[i] - 8388608) / 8388608.0f;
+		case ALLEGRO_AUDIO_DEPTH_FLOAT32:
+			return ((const float*)data)[i];
+	}
+	return 0;
+}
+
+static float ReadFrameChannel(ALLEGRO_SAMPLE *sample, size_t frame, int channel, int channels) {
+	// Maps the sample's channels onto the wanted ones: mono gets duplicated,
+	// anything gets averaged down to mono, extra channels are dropped.
+	const void *data = al_get_sample_data(sample);
+	ALLEGRO_AUDIO_DEPTH depth = al_get_sample_depth(sample);
+	int count = al_get_channel_count(al_get_sample_channels(sample));
+	if (count == 1) {
+		return ReadValue(data, depth, frame);
+	}
+	if (channels == 1) {
+		float sum = 0;
+		int i;
+		for (i = 0; i < count; i++) {
+			sum += ReadValue(data, depth, frame * count + i);
+		}
+		return sum / count;
+	}
+	return ReadValue(data, depth, frame * count + ((channel < count) ? channel : count - 1));
+}
+
+static void* ConvertSample(struct Game *game, ALLEGRO_SAMPLE *sample, struct SampleCacheHeader *header) {
+	// Linear interpolation is plenty for short effects.
+	unsigned int frequency = al_get_sample_frequency(sample);
+	size_t length = al_get_sample_length(sample);
+	int channels = al_get_channel_count(game->data->sample_cache.channels);
+	header->frequency = game->data->sample_cache.frequency;
+	header->depth = game->data->sample_cache.depth;
+	header->channels = game->data->sample_cache.channels;
+	header->length = (uint64_t)length * header->frequency / frequency;
+	size_t size = al_get_audio_depth_size(header->depth);
+	char *pcm = malloc((size_t)header->length * channels * size);
+	uint32_t i;
+	for (i = 0; i < header->length; i++) {
+		double position = (double)i * frequency / header->frequency;
+		size_t frame = position;
+		float fraction = position - frame;
+		size_t next = (frame + 1 < length) ? frame + 1 : frame;
+		int c;
+		for (c = 0; c < channels; c++) {
+			float value = ReadFrameChannel(sample, frame, c, channels) * (1 - fraction) + ReadFrameChannel(sample, next, c, channels) * fraction;
+			size_t index = (size_t)i * channels + c;
+			if (header->depth == ALLEGRO_AUDIO_DEPTH_FLOAT32) {
+				((float*)pcm)[index] = value;
+			} else {
+				value = (value > 1) ? 1 : ((value < -1) ? -1 : value);
+				((int16_t*)pcm)[index] = value * 32767;
+			}
+		}
+	}
+	return pcm;
+}
+
+static bool StoreCacheEntry(struct Game *game, const char *filename, ALLEGRO_SAMPLE *sample, uint64_t hash, size_t size) {
+	struct SampleCacheHeader header = {0};
+	memcpy(header.magic, SAMPLE_CACHE_MAGIC, 4);
+	header.version = SAMPLE_CACHE_VERSION;
+	header.hash = hash;
+	header.size = size;
+	void *pcm = ConvertSample(game, sample, &header);
+	size_t length = (size_t)header.length * al_get_channel_count(header.channels) * al_get_audio_depth_size(header.depth);
+
+	// written aside and renamed, so nobody ever maps a half-written entry
+	char temporary[1024];
+	snprintf(temporary, 1024, "%s.%p.tmp", filename, pcm);
+	FILE *file = fopen(temporary, "wb");
+	bool ok = file && (fwrite(&header, sizeof(header), 1, file) == 1) && (!length || (fwrite(pcm, length, 1, file) == 1));
+	if (file) {
+		ok &= !fclose(file);
+	}
+	free(pcm);
+	if (!ok || rename(temporary, filename)) {
+		remove(temporary);
+		return false;
+	}
+	return true;
+}
+
+static ALLEGRO_SAMPLE* LoadCacheEntry(struct Game *game, const char *filename, uint64_t hash, size_t size) {
+	size_t length = 0;
+	void *file = MapFile(filename, &length);
+	if (!file) {
+		return NULL;
+	}
+	const struct SampleCacheHeader *header = file;
+	struct CommonResources *data = game->data;
+	ALLEGRO_SAMPLE *sample = NULL;
+	if ((length >= sizeof(struct SampleCacheHeader)) && !memcmp(header->magic, SAMPLE_CACHE_MAGIC, 4) &&
+	    (header->version == SAMPLE_CACHE_VERSION) && (header->hash == hash) && (header->size == size) &&
+	    (header->frequency == data->sample_cache.frequency) && (header->depth == (uint32_t)data->sample_cache.depth) &&
+	    (header->channels == (uint32_t)data->sample_cache.channels) &&
+	    (length == sizeof(struct SampleCacheHeader) + (size_t)header->length * al_get_channel_count(header->channels) * al_get_audio_depth_size(header->depth))) {
+		// plays straight from the mapping, which stays until the sample is destroyed
+		sample = al_create_sample((void*)(header + 1), header->length, header->frequency, header->depth, header->channels, false);
+	}
+	if (!sample) {
+		UnmapFile(file, length);
+		return NULL;
+	}
+	struct SampleMapping *mapping = malloc(sizeof(struct SampleMapping));
+	mapping->sample = sample;
+	mapping->file = file;
+	mapping->size = length;
+	al_lock_mutex(data->sample_cache.mutex);
+	mapping->next = data->sample_cache.mappings;
+	data->sample_cache.mappings = mapping;
+	al_unlock_mutex(data->sample_cache.mutex);
+	return sample;
+}
+
+ALLEGRO_SAMPLE* DecodeSample(struct Game *game, const char *filename, const void *contents, size_t size) {
+	// Turns the contents of an audio file into a sample, through the sample
+	// cache when there's one. Safe to call from the loader's worker threads.
+	// Samples made here must be destroyed with DestroySample.
+	char entry[1024];
+	uint64_t hash = 0;
+	const char *cache = game->data ? game->data->sample_cache.dir : NULL;
+	if (cache) {
+		hash = HashContents(contents, size);
+		snprintf(entry, 1024, "%s%c%016llx-%u-%d-%d.pcm", cache, ALLEGRO_NATIVE_PATH_SEP, (unsigned long long)hash,
+		         game->data->sample_cache.frequency, game->data->sample_cache.depth, game->data->sample_cache.channels);
+		ALLEGRO_SAMPLE *sample = LoadCacheEntry(game, entry, hash, size);
+		if (sample) {
+			return sample;
+		}
+	}
+
+	ALLEGRO_FILE *file = OpenMemoryFile(contents, size);
+	if (!file) {
+		return NULL;
+	}
+	ALLEGRO_SAMPLE *sample = al_load_sample_f(file, GetFileExtension(filename));
+	al_fclose(file);
+	if (sample && cache && StoreCacheEntry(game, entry, sample, hash, size)) {
+		// from now on it's the converted one that gets played
+		ALLEGRO_SAMPLE *cached = LoadCacheEntry(game, entry, hash, size);
+		if (cached) {
+			al_destroy_sample(sample);
+			sample = cached;
+		}
+	}
+	return sample;
+}
+
+ALLEGRO_SAMPLE* DecodeSampleFile(struct Game *game, const char *path) {
+	size_t size = 0;
+	void *contents = MapFile(path, &size);
+	if (!contents) {
+		return NULL;
+	}
+	ALLEGRO_SAMPLE *sample = DecodeSample(game, path, contents, size);
+	UnmapFile(contents, size);
+	return sample;
+}
+
+void DestroySample(struct Game *game, ALLEGRO_SAMPLE *sample) {
+	// The mapping goes first: once the sample is freed, a loader worker may
+	// get a new one at the same address and register its own mapping.
+	struct SampleMapping *unused = NULL, **mapping;
+	if (game->data->sample_cache.mutex) {
+		al_lock_mutex(game->data->sample_cache.mutex);
+		for (mapping = &game->data->sample_cache.mappings; *mapping; mapping = &(*mapping)->next) {
+			if ((*mapping)->sample == sample) {
+				unused = *mapping;
+				*mapping = unused->next;
+				break;
+			}
+		}
+		al_unlock_mutex(game->data->sample_cache.mutex);
+	}
+	al_destroy_sample(sample);
+	if (unused) {
+		UnmapFile(unused->file, unused->size);
+		free(unused);
+	}
+}
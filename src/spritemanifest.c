@@ -0,0 +1,112 @@
+/*! \file spritemanifest.c
+ *  \brief Spritesheet descriptions from the compiled manifest instead of ini files.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include "spritemanifest.h"
+#include <libsuperderpy.h>
+
+void LoadSpriteManifest(struct Game *game, struct CommonResources *data) {
+#ifdef DRSAUCE_SPRITE_MANIFEST
+	if (!atoi(GetConfigOptionDefault(game, "DrSauce", "sprite_manifest", "1"))) {
+		return;
+	}
+	size_t size = 0;
+	// used in place when it's in the data archive, mapped separately otherwise
+	void *mapped = NULL;
+	const void *file = GetArchivedFile(game, "sprites/manifest.bin", &size);
+	if (!file) {
+		file = mapped = MapFile(ResolveDataPath(game, "sprites/manifest.bin"), &size);
+	}
+	if (!file) {
+		PrintConsole(game, "Could not load the sprite manifest, reading ini files");
+		return;
+	}
+	const struct SpriteManifestHeader *header = file;
+	if ((size < sizeof(struct SpriteManifestHeader)) || memcmp(header->magic, SPRITE_MANIFEST_MAGIC, 4) ||
+	    (header->version != SPRITE_MANIFEST_VERSION) ||
+	    (size != sizeof(struct SpriteManifestHeader) + header->count * sizeof(struct SpriteManifestRecord))) {
+		PrintConsole(game, "Sprite manifest is invalid, reading ini files");
+		if (mapped) {
+			UnmapFile(mapped, size);
+		}
+		return;
+	}
+	data->manifest.file = mapped;
+	data->manifest.size = size;
+	data->manifest.records = (const struct SpriteManifestRecord*)(header + 1);
+	data->manifest.count = header->count;
+#endif
+}
+
+void DestroySpriteManifest(struct Game *game) {
+	if (game->data->manifest.file) {
+		UnmapFile(game->data->manifest.file, game->data->manifest.size);
+	}
+	game->data->manifest.file = NULL;
+	game->data->manifest.records = NULL;
+	game->data->manifest.count = 0;
+}
+
+struct ManifestKey {
+		const char *character, *spritesheet;
+};
+
+static int CompareRecord(const void *k, const void *r) {
+	const struct ManifestKey *key = k;
+	const struct SpriteManifestRecord *record = r;
+	int result = strncmp(key->character, record->character, SPRITE_MANIFEST_NAME);
+	return result ? result : strncmp(key->spritesheet, record->spritesheet, SPRITE_MANIFEST_NAME);
+}
+
+void RegisterCharacterSpritesheet(struct Game *game, struct Character *character, char *name) {
+	// Drop-in replacement for RegisterSpritesheet that takes the description
+	// from the manifest, falling back to the sheet's ini file.
+	double start = al_get_time();
+	struct ManifestKey key = {character->name, name};
+	const struct SpriteManifestRecord *record = NULL;
+	if (game->data->manifest.records) {
+		record = bsearch(&key, game->data->manifest.records, game->data->manifest.count, sizeof(struct SpriteManifestRecord), CompareRecord);
+	}
+	if (!record) {
+		RegisterSpritesheet(game, character, name);
+	} else {
+		struct Spritesheet *s = character->spritesheets;
+		while (s && strcmp(s->name, name)) {
+			s = s->next;
+		}
+		if (!s) {
+			// tools/spritemanifest refuses ini files with any other keys, so
+			// this is all RegisterSpritesheet would have read from them
+			s = calloc(1, sizeof(struct Spritesheet));
+			s->name = strdup(name);
+			s->rows = record->rows;
+			s->cols = record->cols;
+			s->blanks = record->blanks;
+			s->delay = record->delay;
+			s->next = character->spritesheets;
+			character->spritesheets = s;
+		}
+	}
+	double time = al_get_time() - start;
+	game->data->manifest.time += time;
+	PrintConsole(game, "Registered %s for %s from %s in %.3f ms (%.3f ms in total)", name, character->name,
+	             record ? "the manifest" : "its ini file", time * 1000, game->data->manifest.time * 1000);
+}
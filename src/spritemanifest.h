@@ -0,0 +1,44 @@
+/*! \file spritemanifest.h
+ *  \brief On-disk format of the compiled spritesheet manifest.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+// Written by tools/spritemanifest, read by the game with a single mmap.
+// A header followed by fixed-size records sorted by character, then sheet
+// name, so lookups are a binary search. Native byte order; the file is
+// generated on the machine the game is built for.
+
+#include <stdint.h>
+
+#define SPRITE_MANIFEST_MAGIC "DSSM"
+#define SPRITE_MANIFEST_VERSION 2
+#define SPRITE_MANIFEST_NAME 32
+
+struct SpriteManifestHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t count;
+};
+
+struct SpriteManifestRecord {
+		char character[SPRITE_MANIFEST_NAME];
+		char spritesheet[SPRITE_MANIFEST_NAME];
+		int32_t rows, cols, blanks;
+		float delay; // atof'd by the engine too, so it may be fractional
+};
@@ -0,0 +1,129 @@
+/*! \file textcache.c
+ *  \brief Cache of pre-rendered text strings.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+static void FreeEntry(struct TextCacheEntry *entry) {
+	if (entry->bitmap) {
+		al_destroy_bitmap(entry->bitmap);
+	}
+	free(entry->text);
+	memset(entry, 0, sizeof(struct TextCacheEntry));
+}
+
+static void RenderEntry(struct TextCacheEntry *entry, ALLEGRO_COLOR color) {
+	int bbx, bby, bbw, bbh;
+	al_get_text_dimensions(entry->font, entry->text, &bbx, &bby, &bbw, &bbh);
+	entry->width = al_get_text_width(entry->font, entry->text);
+	if (!bbw || !bbh) {
+		return;
+	}
+
+	// 1px of padding around the glyphs plus room for the shadow offset.
+	entry->x = 1 - bbx;
+	entry->y = 1 - bby;
+
+	int flags = al_get_new_bitmap_flags();
+	al_add_new_bitmap_flag(ALLEGRO_NO_PRESERVE_TEXTURE);
+	entry->bitmap = al_create_bitmap(bbw + 3, bbh + 3);
+	al_set_new_bitmap_flags(flags);
+	if (!entry->bitmap) {
+		return;
+	}
+
+	bool held = al_is_bitmap_drawing_held();
+	if (held) {
+		al_hold_bitmap_drawing(false);
+	}
+	ALLEGRO_BITMAP *target = al_get_target_bitmap();
+	al_set_target_bitmap(entry->bitmap);
+	al_clear_to_color(al_map_rgba(0,0,0,0));
+	if (entry->shadow) {
+		DrawTextWithShadow(entry->font, color, entry->x, entry->y, ALLEGRO_ALIGN_LEFT, entry->text);
+	} else {
+		al_draw_text(entry->font, color, entry->x, entry->y, ALLEGRO_ALIGN_LEFT, entry->text);
+	}
+	al_set_target_bitmap(target);
+	if (held) {
+		al_hold_bitmap_drawing(true);
+	}
+}
+
+ALLEGRO_BITMAP* GetCachedText(struct Game *game, ALLEGRO_FONT *font, ALLEGRO_COLOR color, const char *text, bool shadow, int flags, float *x, float *y) {
+	// Looks up (or renders) the text and turns the pen position in x/y into
+	// the position the returned bitmap should be drawn at. NULL when there's
+	// nothing to draw.
+	struct TextCacheEntry *cache = game->data->text_cache;
+	unsigned char rgba[4];
+	al_unmap_rgba(color, &rgba[0], &rgba[1], &rgba[2], &rgba[3]);
+
+	struct TextCacheEntry *entry = NULL, *victim = &cache[0];
+	int i;
+	for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+		if (cache[i].text && (cache[i].font == font) && (cache[i].shadow == shadow) &&
+		    !memcmp(cache[i].rgba, rgba, sizeof(rgba)) && !strcmp(cache[i].text, text)) {
+			entry = &cache[i];
+			break;
+		}
+		if (!cache[i].text) {
+			if (victim->text) {
+				victim = &cache[i];
+			}
+		} else if (victim->text && (cache[i].used < victim->used)) {
+			victim = &cache[i];
+		}
+	}
+
+	if (!entry) {
+		entry = victim;
+		FreeEntry(entry);
+		entry->font = font;
+		memcpy(entry->rgba, rgba, sizeof(rgba));
+		entry->shadow = shadow;
+		entry->text = strdup(text);
+		RenderEntry(entry, color);
+	}
+	entry->used = ++game->data->text_cache_clock;
+
+	if (flags & ALLEGRO_ALIGN_CENTRE) {
+		*x -= entry->width / 2;
+	} else if (flags & ALLEGRO_ALIGN_RIGHT) {
+		*x -= entry->width;
+	}
+	if (flags & ALLEGRO_ALIGN_INTEGER) {
+		*x = (int)*x;
+	}
+	*x -= entry->x;
+	*y -= entry->y;
+	return entry->bitmap;
+}
+
+void InvalidateTextCache(struct Game *game, ALLEGRO_FONT *font) {
+	// Drops every entry rendered with the given font, or all of them when NULL.
+	// Must be called before destroying a font that may have been used here.
+	int i;
+	for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+		if (game->data->text_cache[i].text && (!font || (game->data->text_cache[i].font == font))) {
+			FreeEntry(&game->data->text_cache[i]);
+		}
+	}
+}
@@ -0,0 +1,211 @@
+/*! \file texturecache.c
+ *  \brief Decoded pixels of data bitmaps, cached across runs.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+#include <allegro5/allegro_memfile.h>
+#include <stdint.h>
+
+// Decoding PNGs (inflating and unfiltering) is most of what loading a
+// bitmap costs, and it's the same work on every launch. So the pixels
+// Allegro ends up with are kept in the user's cache directory, one file
+// per source image named after a hash of its contents. A changed image
+// hashes differently and simply gets a new entry; an entry that doesn't
+// match what's expected of it is rebuilt.
+
+#define TEXTURE_CACHE_MAGIC "DSTX"
+#define TEXTURE_CACHE_VERSION 1
+
+struct TextureCacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t hash; // of the source file
+		uint64_t size; // of the source file
+		uint32_t width, height;
+		uint32_t premultiplied;
+		uint32_t reserved;
+		// followed by width*height RGBA pixels, rows top to bottom
+};
+
+uint64_t HashContents(const void *contents, size_t size) {
+	// FNV-1a
+	const unsigned char *bytes = contents;
+	uint64_t hash = 14695981039346656037ULL;
+	size_t i;
+	for (i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+char* CreateCacheDirectory(struct Game *game, const char *name) {
+	// The named subdirectory of the user's cache directory, created if needed.
+	// NULL when that's not possible.
+	ALLEGRO_PATH *path = NULL;
+#if defined(__linux__)
+	const char *xdg = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	if (xdg && xdg[0]) {
+		path = al_create_path_for_directory(xdg);
+	} else if (home) {
+		path = al_create_path_for_directory(home);
+		al_append_path_component(path, ".cache");
+	}
+	if (path) {
+		al_append_path_component(path, al_get_app_name());
+	}
+#endif
+	if (!path) {
+		path = al_get_standard_path(ALLEGRO_USER_DATA_PATH);
+		al_append_path_component(path, "cache");
+	}
+	al_append_path_component(path, name);
+	const char *dir = al_path_cstr(path, ALLEGRO_NATIVE_PATH_SEP);
+	char *result = NULL;
+	if (al_make_directory(dir)) {
+		result = strdup(dir);
+	} else {
+		PrintConsole(game, "Could not create the cache directory %s", dir);
+	}
+	al_destroy_path(path);
+	return result;
+}
+
+void OpenTextureCache(struct Game *game, struct CommonResources *data) {
+	if (!atoi(GetConfigOptionDefault(game, "DrSauce", "texture_cache", "1"))) {
+		return;
+	}
+	data->texture_cache = CreateCacheDirectory(game, "textures");
+	if (data->texture_cache) {
+		PrintConsole(game, "Texture cache: %s", data->texture_cache);
+	}
+}
+
+void CloseTextureCache(struct Game *game) {
+	free(game->data->texture_cache);
+	game->data->texture_cache = NULL;
+}
+
+static ALLEGRO_BITMAP* LoadCacheEntry(const char *filename, uint64_t hash, size_t size, bool premultiplied) {
+	size_t length = 0;
+	void *file = MapFile(filename, &length);
+	if (!file) {
+		return NULL;
+	}
+	const struct TextureCacheHeader *header = file;
+	ALLEGRO_BITMAP *bitmap = NULL;
+	if ((length >= sizeof(struct TextureCacheHeader)) && !memcmp(header->magic, TEXTURE_CACHE_MAGIC, 4) &&
+	    (header->version == TEXTURE_CACHE_VERSION) && (header->hash == hash) && (header->size == size) &&
+	    (header->premultiplied == premultiplied) &&
+	    (length == sizeof(struct TextureCacheHeader) + (size_t)header->width * header->height * 4)) {
+		bitmap = al_create_bitmap(header->width, header->height);
+	}
+	if (bitmap) {
+		// the upload happens from the mapped pixels when this gets unlocked
+		ALLEGRO_LOCKED_REGION *lock = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+		if (lock) {
+			const char *pixels = (const char*)(header + 1);
+			uint32_t y;
+			for (y = 0; y < header->height; y++) {
+				memcpy((char*)lock->data + y * lock->pitch, pixels + (size_t)y * header->width * 4, header->width * 4);
+			}
+			al_unlock_bitmap(bitmap);
+		} else {
+			al_destroy_bitmap(bitmap);
+			bitmap = NULL;
+		}
+	}
+	UnmapFile(file, length);
+	return bitmap;
+}
+
+static void StoreCacheEntry(const char *filename, ALLEGRO_BITMAP *bitmap, uint64_t hash, size_t size, bool premultiplied) {
+	ALLEGRO_LOCKED_REGION *lock = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+	if (!lock) {
+		return;
+	}
+	struct TextureCacheHeader header = {0};
+	memcpy(header.magic, TEXTURE_CACHE_MAGIC, 4);
+	header.version = TEXTURE_CACHE_VERSION;
+	header.hash = hash;
+	header.size = size;
+	header.width = al_get_bitmap_width(bitmap);
+	header.height = al_get_bitmap_height(bitmap);
+	header.premultiplied = premultiplied;
+
+	// written aside and renamed, so nobody ever maps a half-written entry
+	char temporary[1024];
+	snprintf(temporary, 1024, "%s.%p.tmp", filename, (void*)bitmap);
+	FILE *file = fopen(temporary, "wb");
+	bool ok = file && (fwrite(&header, sizeof(header), 1, file) == 1);
+	uint32_t y;
+	for (y = 0; ok && (y < header.height); y++) {
+		ok = fwrite((char*)lock->data + y * lock->pitch, header.width * 4, 1, file) == 1;
+	}
+	al_unlock_bitmap(bitmap);
+	if (file) {
+		ok &= !fclose(file);
+	}
+	if (!ok || rename(temporary, filename)) {
+		remove(temporary);
+	}
+}
+
+ALLEGRO_BITMAP* DecodeBitmap(struct Game *game, const char *filename, const void *contents, size_t size) {
+	// Turns the contents of an image file into a bitmap created with the calling
+	// thread's new bitmap flags, through the texture cache when there's one.
+	// Safe to call from the loader's worker threads.
+	char entry[1024];
+	uint64_t hash = 0;
+	bool premultiplied = !(al_get_new_bitmap_flags() & ALLEGRO_NO_PREMULTIPLIED_ALPHA);
+	const char *cache = game->data ? game->data->texture_cache : NULL;
+	if (cache) {
+		hash = HashContents(contents, size);
+		snprintf(entry, 1024, "%s%c%016llx.tex", cache, ALLEGRO_NATIVE_PATH_SEP, (unsigned long long)hash);
+		ALLEGRO_BITMAP *bitmap = LoadCacheEntry(entry, hash, size, premultiplied);
+		if (bitmap) {
+			return bitmap;
+		}
+	}
+
+	ALLEGRO_FILE *file = OpenMemoryFile(contents, size);
+	if (!file) {
+		return NULL;
+	}
+	ALLEGRO_BITMAP *bitmap = al_load_bitmap_f(file, GetFileExtension(filename));
+	al_fclose(file);
+	if (bitmap && cache) {
+		StoreCacheEntry(entry, bitmap, hash, size, premultiplied);
+	}
+	return bitmap;
+}
+
+ALLEGRO_BITMAP* DecodeBitmapFile(struct Game *game, const char *path) {
+	size_t size = 0;
+	void *contents = MapFile(path, &size);
+	if (!contents) {
+		return NULL;
+	}
+	ALLEGRO_BITMAP *bitmap = DecodeBitmap(game, path, contents, size);
+	UnmapFile(contents, size);
+	return bitmap;
+}
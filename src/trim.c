@@ -0,0 +1,112 @@
+/*! \file trim.c
+ *  \brief Drawing spritesheet frames without their transparent margins.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+// Frame bounds come from sprites/trim.ini, generated at build time by
+// tools/trimsprites. Characters without an entry there are drawn as usual.
+
+void LoadSpriteTrims(struct Game *game, struct CommonResources *data) {
+#ifdef DRSAUCE_TRIMMED_SPRITES
+	ALLEGRO_CONFIG *config = LoadDataConfig(game, "sprites/trim.ini");
+	if (!config) {
+		PrintConsole(game, "Could not load sprite trimming data, drawing whole frames");
+		return;
+	}
+	ALLEGRO_CONFIG_SECTION *iterator;
+	const char *section = al_get_first_config_section(config, &iterator);
+	while (section) {
+		const char *separator = strchr(section, '/');
+		const char *value = al_get_config_value(config, section, "frames");
+		if (separator && value) {
+			data->trims = realloc(data->trims, sizeof(struct SpriteTrim) * (data->trim_count + 1));
+			struct SpriteTrim *trim = &data->trims[data->trim_count++];
+			trim->character = strndup(section, separator - section);
+			trim->spritesheet = strdup(separator + 1);
+			trim->frames = atoi(value);
+			trim->rects = calloc(trim->frames, sizeof(*trim->rects));
+			int i;
+			for (i = 0; i < trim->frames; i++) {
+				char key[16];
+				snprintf(key, 16, "%d", i);
+				value = al_get_config_value(config, section, key);
+				if (!value || sscanf(value, "%d %d %d %d", &trim->rects[i][0], &trim->rects[i][1], &trim->rects[i][2], &trim->rects[i][3]) != 4) {
+					// unknown bounds, so keep the whole frame
+					trim->rects[i][0] = trim->rects[i][1] = 0;
+					trim->rects[i][2] = trim->rects[i][3] = -1;
+				}
+			}
+		}
+		section = al_get_next_config_section(&iterator);
+	}
+	al_destroy_config(config);
+#endif
+}
+
+void DestroySpriteTrims(struct Game *game) {
+	int i;
+	for (i = 0; i < game->data->trim_count; i++) {
+		free(game->data->trims[i].character);
+		free(game->data->trims[i].spritesheet);
+		free(game->data->trims[i].rects);
+	}
+	free(game->data->trims);
+	game->data->trims = NULL;
+	game->data->trim_count = 0;
+}
+
+static struct SpriteTrim* FindSpriteTrim(struct Game *game, struct Character *character) {
+	int i;
+	for (i = 0; i < game->data->trim_count; i++) {
+		if (!strcmp(game->data->trims[i].spritesheet, character->spritesheet->name) &&
+		    !strcmp(game->data->trims[i].character, character->name)) {
+			return &game->data->trims[i];
+		}
+	}
+	return NULL;
+}
+
+bool GetCharacterTrim(struct Game *game, struct Character *character, int flags, float *x, float *y, int *sx, int *sy, int *w, int *h) {
+	// Fills in the source region of the current frame that has any opaque
+	// pixels and where to draw it so it lands exactly where the whole frame
+	// would. Returns false when the frame has to be drawn the usual way.
+	struct Spritesheet *spritesheet = character->spritesheet;
+	if (character->angle != 0) {
+		return false;
+	}
+	struct SpriteTrim *trim = FindSpriteTrim(game, character);
+	if (!trim || (trim->frames != spritesheet->rows * spritesheet->cols - spritesheet->blanks) ||
+	    (character->pos >= trim->frames) || (trim->rects[character->pos][2] < 0)) {
+		return false;
+	}
+	int *rect = trim->rects[character->pos];
+	int fw = al_get_bitmap_width(spritesheet->bitmap) / spritesheet->cols;
+	int fh = al_get_bitmap_height(spritesheet->bitmap) / spritesheet->rows;
+
+	*sx = (character->pos % spritesheet->cols) * fw + rect[0];
+	*sy = (character->pos / spritesheet->cols) * fh + rect[1];
+	*w = rect[2];
+	*h = rect[3];
+	*x = GetCharacterX(game, character) + ((flags & ALLEGRO_FLIP_HORIZONTAL) ? fw - rect[0] - rect[2] : rect[0]);
+	*y = GetCharacterY(game, character) + ((flags & ALLEGRO_FLIP_VERTICAL) ? fh - rect[1] - rect[3] : rect[1]);
+	return true;
+}
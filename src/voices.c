@@ -0,0 +1,256 @@
+/*! \file voices.c
+ *  \brief Narration lines, opened when spoken and kept around when short.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "common.h"
+#include <libsuperderpy.h>
+
+// Every voice line is known by its id, the name of its file in voice/.
+// Nothing gets opened until the line is actually spoken; the first time,
+// it's streamed. Short lines are then decoded in the background on the
+// asset queue, so when one comes up again (like the tape machine's
+// complaints) it plays from memory. Decoded lines are kept in least
+// recently used order, up to voice_cache_kb kilobytes of PCM.
+//
+// Lines don't get polled to find out when they're over. The voice mixer's
+// postprocess callback, on the audio thread, notices a line has stopped
+// and flags it with atomics only. The next time the main thread sees an
+// event (or the HUD ticks), DispatchVoiceEvents takes the subtitle down
+// and marks the line done, which is what Speak waits for.
+
+#define VOICE_BUFFERS 4
+#define VOICE_BUFFER_SAMPLES 1024
+#define VOICE_CLIP_MAX (256 * 1024) // larger files are always streamed
+
+static struct Voice* FindVoice(struct Game *game, const char *id) {
+	// Voices are indexed on first use; the entry lives as long as the game data.
+	struct Voice *voice;
+	for (voice = game->data->voices.list; voice; voice = voice->next) {
+		if (!strcmp(voice->id, id)) {
+			return voice;
+		}
+	}
+	voice = calloc(1, sizeof(struct Voice));
+	voice->id = strdup(id);
+	snprintf(voice->filename, sizeof(voice->filename), "voice/%s.flac", id);
+	voice->next = game->data->voices.list;
+	game->data->voices.list = voice;
+	return voice;
+}
+
+static size_t GetSampleSize(ALLEGRO_SAMPLE *sample) {
+	return al_get_sample_length(sample) * al_get_channel_count(al_get_sample_channels(sample)) *
+	       al_get_audio_depth_size(al_get_sample_depth(sample));
+}
+
+static void EvictVoice(struct Game *game, struct Voice *voice) {
+	game->data->voices.cached -= GetSampleSize(voice->sample);
+	ReleaseResource(game, voice->sample);
+	voice->sample = NULL;
+}
+
+static void TrimVoices(struct Game *game) {
+	// Counts the lines the asset queue has decoded since last time, then drops
+	// the least recently used ones (that aren't playing) until under the limit.
+	struct Voice *voice;
+	for (voice = game->data->voices.list; voice; voice = voice->next) {
+		if (voice->queued && voice->sample) {
+			voice->queued = false;
+			game->data->voices.cached += GetSampleSize(voice->sample);
+		}
+	}
+	while (game->data->voices.cached > game->data->voices.limit) {
+		struct Voice *oldest = NULL;
+		for (voice = game->data->voices.list; voice; voice = voice->next) {
+			if (voice->sample && !voice->queued && !voice->playing && (!oldest || (voice->used < oldest->used))) {
+				oldest = voice;
+			}
+		}
+		if (!oldest) {
+			return;
+		}
+		EvictVoice(game, oldest);
+	}
+}
+
+static void NoProgress(struct Game *game) {}
+
+static void CacheVoice(struct Game *game, struct Voice *voice) {
+	// Has a short line that was just streamed decoded in the background, so
+	// it's at hand next time. The file size is only looked up once.
+	if (voice->sample || voice->queued || !game->data->voices.limit) {
+		return;
+	}
+	if (!voice->size && !GetArchivedFile(game, voice->filename, &voice->size)) {
+		ALLEGRO_FILE *file = OpenDataFile(game, voice->filename);
+		voice->size = file ? al_fsize(file) : (size_t)-1; // an unreadable one won't get any better
+		if (file) {
+			al_fclose(file);
+		}
+	}
+	if (voice->size > VOICE_CLIP_MAX) {
+		return;
+	}
+	struct Asset asset = {RESOURCE_SAMPLE, voice->filename, &voice->sample};
+	voice->queued = true;
+	QueueAssets(game, &asset, 1, NoProgress); // put in place by the HUD's PumpAssets
+}
+
+static bool IsLinePlaying(struct VoiceLine *line) {
+	if (line->instance) {
+		return al_get_sample_instance_playing(line->instance);
+	}
+	return al_get_audio_stream_playing(line->stream);
+}
+
+static void VoicesMixed(void *buf, unsigned int samples, void *arg) {
+	// Audio thread. Lines are only ever flagged here; everything else is up
+	// to the main thread.
+	struct CommonResources *data = arg;
+	int i;
+	for (i = 0; i < VOICE_SLOTS; i++) {
+		struct VoiceLine *line = __atomic_load_n(&data->voices.active[i], __ATOMIC_ACQUIRE);
+		if (line && !__atomic_load_n(&line->finished, __ATOMIC_RELAXED) && !IsLinePlaying(line)) {
+			__atomic_store_n(&line->finished, true, __ATOMIC_RELEASE);
+			__atomic_add_fetch(&data->voices.generation, 1, __ATOMIC_RELEASE);
+		}
+	}
+}
+
+void InitVoices(struct Game *game, struct CommonResources *data) {
+	data->voices.limit = atoi(GetConfigOptionDefault(game, "DrSauce", "voice_cache_kb", "2048")) * 1024;
+	al_set_mixer_postprocess_callback(game->audio.voice, VoicesMixed, data);
+}
+
+void DispatchVoiceEvents(struct Game *game) {
+	// Cheap when nothing finished since last time.
+	struct CommonResources *data = game->data;
+	unsigned int generation = __atomic_load_n(&data->voices.generation, __ATOMIC_ACQUIRE);
+	if (generation == data->voices.seen) {
+		return;
+	}
+	data->voices.seen = generation;
+	int i;
+	for (i = 0; i < VOICE_SLOTS; i++) {
+		struct VoiceLine *line = data->voices.active[i];
+		if (line && !line->done && __atomic_load_n(&line->finished, __ATOMIC_ACQUIRE)) {
+			line->done = true;
+			if (line->text && (data->text == line->text)) {
+				data->text = NULL;
+				RequestRedraw(game);
+			}
+		}
+	}
+}
+
+void DestroyVoices(struct Game *game) {
+	// Lines still queued in timelines have to be gone by now.
+	al_set_mixer_postprocess_callback(game->audio.voice, NULL, NULL);
+	WaitForAssets(game); // queued decodes write into the voices
+	while (game->data->voices.list) {
+		struct Voice *voice = game->data->voices.list;
+		game->data->voices.list = voice->next;
+		if (voice->sample) {
+			ReleaseResource(game, voice->sample);
+		}
+		free(voice->id);
+		free(voice);
+	}
+	game->data->voices.cached = 0;
+}
+
+struct VoiceLine* CreateVoiceLine(struct Game *game, const char *id) {
+	// Cheap; meant to be queued as a timeline argument well ahead of time.
+	struct VoiceLine *line = calloc(1, sizeof(struct VoiceLine));
+	line->voice = FindVoice(game, id);
+	line->slot = -1;
+	return line;
+}
+
+static void WatchVoiceLine(struct Game *game, struct VoiceLine *line) {
+	// Only once it's playing, or the audio thread would take it as finished.
+	int i;
+	for (i = 0; i < VOICE_SLOTS; i++) {
+		if (!game->data->voices.active[i]) {
+			line->slot = i;
+			__atomic_store_n(&game->data->voices.active[i], line, __ATOMIC_RELEASE);
+			return;
+		}
+	}
+	// too many at once; this one will just be treated as over
+	PrintConsole(game, "No slot left for voice %s", line->voice->id);
+	line->finished = line->done = true;
+}
+
+void StartVoiceLine(struct Game *game, struct VoiceLine *line, char *text) {
+	// Plays the line with the given subtitle, which gets taken down as soon as it ends.
+	struct Voice *voice = line->voice;
+	voice->used = al_get_time();
+	voice->playing++;
+	TrimVoices(game); // not this one, it's playing now
+	line->started = true;
+	line->text = text;
+	game->data->text = text;
+	if (voice->sample) {
+		line->instance = al_create_sample_instance(voice->sample);
+		al_attach_sample_instance_to_mixer(line->instance, game->audio.voice);
+		al_play_sample_instance(line->instance);
+		WatchVoiceLine(game, line);
+		return;
+	}
+	line->stream = LoadDataAudioStream(game, voice->filename, VOICE_BUFFERS, VOICE_BUFFER_SAMPLES);
+	if (!line->stream) {
+		PrintConsole(game, "Could not stream voice %s", voice->id);
+		line->finished = line->done = true;
+		return;
+	}
+	al_set_audio_stream_playmode(line->stream, ALLEGRO_PLAYMODE_ONCE);
+	al_attach_audio_stream_to_mixer(line->stream, game->audio.voice);
+	al_set_audio_stream_playing(line->stream, true);
+	WatchVoiceLine(game, line);
+}
+
+bool IsVoiceLineFinished(struct VoiceLine *line) {
+	// Set when the finish was dispatched, not polled from the audio system.
+	return line->done;
+}
+
+void DestroyVoiceLine(struct Game *game, struct VoiceLine *line) {
+	// Whether it was ever started or not.
+	bool streamed = line->stream;
+	if (line->slot >= 0) {
+		// destroying the stream or instance below waits for the mixer, so
+		// the audio thread is done looking at the line before it's freed
+		__atomic_store_n(&game->data->voices.active[line->slot], NULL, __ATOMIC_RELEASE);
+	}
+	if (line->instance) {
+		al_destroy_sample_instance(line->instance);
+	}
+	if (line->stream) {
+		al_destroy_audio_stream(line->stream);
+	}
+	if (line->started) {
+		line->voice->playing--;
+	}
+	if (streamed) {
+		CacheVoice(game, line->voice);
+	}
+	free(line);
+}
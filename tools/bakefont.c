@@ -0,0 +1,145 @@
+/*! \file bakefont.c
+ *  \brief Build-time tool rasterizing a TTF font into a bitmap font.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+// Usage: bakefont <font.ttf> <size> <output.png>
+//
+// Renders the printable ASCII range into a bitmap in the format taken by
+// al_grab_font_from_bitmap: every glyph in its own cell, cells separated by
+// the background colour of the top-left pixel. Glyphs are stored with
+// straight alpha, since loading the PNG premultiplies it again.
+//
+// A cell covers the glyph's advance and its bounding box, so shapes that
+// overhang their advance (italics, decorative tails) aren't clipped. That
+// format has no separate advance, so such a glyph advances by its whole
+// cell, and kerning pairs from the TTF are lost altogether. All cells share
+// one height covering every glyph's box, keeping the baselines aligned.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#include <allegro5/allegro_font.h>
+#include <allegro5/allegro_ttf.h>
+
+#define FIRST_GLYPH 32
+#define LAST_GLYPH 126
+#define MAX_WIDTH 512
+
+static void Unpremultiply(ALLEGRO_BITMAP *bitmap) {
+	int w = al_get_bitmap_width(bitmap), h = al_get_bitmap_height(bitmap), x, y;
+	ALLEGRO_LOCKED_REGION *lock = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READWRITE);
+	for (y = 0; y < h; y++) {
+		unsigned char *row = (unsigned char*)lock->data + y * lock->pitch;
+		for (x = 0; x < w; x++) {
+			unsigned char *pixel = row + x * 4;
+			if (pixel[3] && (pixel[3] < 255)) {
+				pixel[0] = pixel[0] * 255 / pixel[3];
+				pixel[1] = pixel[1] * 255 / pixel[3];
+				pixel[2] = pixel[2] * 255 / pixel[3];
+			}
+		}
+	}
+	al_unlock_bitmap(bitmap);
+}
+
+int main(int argc, char **argv) {
+	if (argc != 4) {
+		fprintf(stderr, "Usage: %s <font.ttf> <size> <output.png>\n", argv[0]);
+		return 1;
+	}
+	if (!al_init() || !al_init_image_addon() || !al_init_font_addon() || !al_init_ttf_addon()) {
+		fprintf(stderr, "Could not initialize Allegro\n");
+		return 1;
+	}
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+	al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE);
+
+	// same flags the game loads it with
+	ALLEGRO_FONT *font = al_load_ttf_font(argv[1], atoi(argv[2]), 0);
+	if (!font) {
+		fprintf(stderr, "Could not read %s\n", argv[1]);
+		return 1;
+	}
+	// The vertical extent shared by all cells, relative to the line's top.
+	int top = 0, bottom = al_get_font_line_height(font), c;
+	int lefts[LAST_GLYPH - FIRST_GLYPH + 1];
+	int widths[LAST_GLYPH - FIRST_GLYPH + 1], xs[LAST_GLYPH - FIRST_GLYPH + 1], ys[LAST_GLYPH - FIRST_GLYPH + 1];
+	for (c = FIRST_GLYPH; c <= LAST_GLYPH; c++) {
+		int i = c - FIRST_GLYPH;
+		int advance = al_get_glyph_advance(font, c, ALLEGRO_NO_KERNING);
+		int bbx = 0, bby = 0, bbw = 0, bbh = 0;
+		if (!al_get_glyph_dimensions(font, c, &bbx, &bby, &bbw, &bbh)) {
+			bbw = bbh = 0; // nothing drawn, like the space
+		}
+		lefts[i] = (bbw && (bbx < 0)) ? bbx : 0;
+		int right = (bbw && (bbx + bbw > advance)) ? bbx + bbw : advance;
+		widths[i] = right - lefts[i];
+		if (widths[i] < 1) {
+			widths[i] = 1;
+		}
+		if (bbh && (bby < top)) {
+			top = bby;
+		}
+		if (bbh && (bby + bbh > bottom)) {
+			bottom = bby + bbh;
+		}
+	}
+	int height = bottom - top;
+
+	// Lay the cells out in rows first, to know how big the bitmap has to be.
+	int x = 1, y = 1, w = 0;
+	for (c = FIRST_GLYPH; c <= LAST_GLYPH; c++) {
+		int i = c - FIRST_GLYPH;
+		if (x + widths[i] + 1 > MAX_WIDTH) {
+			x = 1;
+			y += height + 1;
+		}
+		xs[i] = x;
+		ys[i] = y;
+		x += widths[i] + 1;
+		if (x > w) {
+			w = x;
+		}
+	}
+
+	ALLEGRO_COLOR background = al_map_rgb(255, 0, 255);
+	ALLEGRO_BITMAP *bitmap = al_create_bitmap(w, y + height + 1);
+	al_set_target_bitmap(bitmap);
+	al_clear_to_color(background);
+	for (c = FIRST_GLYPH; c <= LAST_GLYPH; c++) {
+		char text[2] = {c, 0};
+		int i = c - FIRST_GLYPH;
+		// the cell holds the whole box, the clipping only guards the separators
+		al_set_clipping_rectangle(xs[i], ys[i], widths[i], height);
+		al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+		al_draw_text(font, al_map_rgb(255, 255, 255), xs[i] - lefts[i], ys[i] - top, 0, text);
+	}
+	al_reset_clipping_rectangle();
+	Unpremultiply(bitmap);
+
+	if (!al_save_bitmap(argv[3], bitmap)) {
+		fprintf(stderr, "Could not write %s\n", argv[3]);
+		return 1;
+	}
+	al_destroy_bitmap(bitmap);
+	al_destroy_font(font);
+	return 0;
+}
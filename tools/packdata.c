@@ -0,0 +1,218 @@
+/*! \file packdata.c
+ *  \brief Build-time tool packing the whole data directory into a single archive.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+// Usage: packdata <output file> <data directory> <generated data directory>
+//
+// See src/dataarchive.h for the format. Run it after the other tools, so
+// their output (in the generated data directory) ends up in the archive as
+// well. Anything the tools generate is only ever taken from there, so what's
+// left over in the data directory from older in-tree builds stays out.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <allegro5/allegro.h>
+#include "../src/dataarchive.h"
+
+struct File {
+		char path[DATA_ARCHIVE_PATH];
+		char *filename;
+		uint64_t size;
+		int group;
+};
+
+struct Files {
+		struct File *files;
+		int count;
+};
+
+static int GetGroup(const char *path) {
+	// Contents are laid out in about the order the game reads them: sprite
+	// data at startup, then fonts, then the gamestates' own assets, with
+	// the voice lines (streamed while the intro plays) at the very end.
+	if (!strncmp(path, "sprites/", 8)) {
+		return 0;
+	}
+	if (!strncmp(path, "fonts/", 6)) {
+		return 1;
+	}
+	if (!strncmp(path, "voice/", 6)) {
+		return 3;
+	}
+	return 2;
+}
+
+static bool IsGenerated(const char *path) {
+	// what data/CMakeLists.txt has the other tools write
+	const char *extension = strrchr(path, '.');
+	return !strcmp(path, "sprites/trim.ini") || !strcmp(path, "sprites/manifest.bin") ||
+	       !strncmp(path, "sprites/atlas", 13) || (!strncmp(path, "fonts/", 6) && extension && !strcmp(extension, ".png"));
+}
+
+static bool IsPacked(const char *path, bool generated) {
+	// build scripts, desktop integration and archives (this one included) stay out
+	const char *name = strrchr(path, '/');
+	name = name ? name + 1 : path;
+	if ((name[0] == '.') || !strcmp(name, "CMakeLists.txt")) {
+		return false;
+	}
+	const char *extension = strrchr(name, '.');
+	if (extension && (!strcmp(extension, ".desktop") || !strcmp(extension, ".pak"))) {
+		return false;
+	}
+	return generated || !IsGenerated(path);
+}
+
+static bool AddFiles(ALLEGRO_FS_ENTRY *dir, const char *prefix, bool generated, struct Files *files) {
+	bool ok = true;
+	if (!al_open_directory(dir)) {
+		fprintf(stderr, "Could not open %s\n", al_get_fs_entry_name(dir));
+		return false;
+	}
+	ALLEGRO_FS_ENTRY *entry;
+	while ((entry = al_read_directory(dir))) {
+		ALLEGRO_PATH *path = al_create_path(al_get_fs_entry_name(entry));
+		char relative[1024];
+		snprintf(relative, 1024, "%s%s", prefix, al_get_path_filename(path));
+		if (al_get_fs_entry_mode(entry) & ALLEGRO_FILEMODE_ISDIR) {
+			// directories come back without a trailing separator
+			char subprefix[1024];
+			snprintf(subprefix, 1024, "%s/", relative);
+			if (strcmp(relative, "icons")) {
+				ok &= AddFiles(entry, subprefix, generated, files);
+			}
+		} else if (IsPacked(relative, generated)) {
+			if (strlen(relative) >= DATA_ARCHIVE_PATH) {
+				fprintf(stderr, "Path %s is too long\n", relative);
+				ok = false;
+			} else {
+				files->files = realloc(files->files, sizeof(struct File) * (files->count + 1));
+				struct File *file = &files->files[files->count++];
+				memset(file->path, 0, DATA_ARCHIVE_PATH);
+				strcpy(file->path, relative);
+				file->filename = strdup(al_get_fs_entry_name(entry));
+				file->size = al_get_fs_entry_size(entry);
+				file->group = GetGroup(relative);
+			}
+		}
+		al_destroy_path(path);
+		al_destroy_fs_entry(entry);
+	}
+	al_close_directory(dir);
+	return ok;
+}
+
+static int CompareLayout(const void *a, const void *b) {
+	const struct File *f1 = a, *f2 = b;
+	return (f1->group != f2->group) ? (f1->group - f2->group) : strcmp(f1->path, f2->path);
+}
+
+static int CompareEntries(const void *a, const void *b) {
+	const struct DataArchiveEntry *e1 = a, *e2 = b;
+	return strcmp(e1->path, e2->path);
+}
+
+static uint64_t Align(uint64_t offset) {
+	return (offset + DATA_ARCHIVE_ALIGN - 1) / DATA_ARCHIVE_ALIGN * DATA_ARCHIVE_ALIGN;
+}
+
+static bool CopyFile(FILE *out, const char *filename, uint64_t size) {
+	FILE *in = fopen(filename, "rb");
+	if (!in) {
+		return false;
+	}
+	char buffer[65536];
+	uint64_t left = size;
+	while (left) {
+		size_t chunk = (left < sizeof(buffer)) ? left : sizeof(buffer);
+		if ((fread(buffer, 1, chunk, in) != chunk) || (fwrite(buffer, 1, chunk, out) != chunk)) {
+			fclose(in);
+			return false;
+		}
+		left -= chunk;
+	}
+	fclose(in);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	if (argc != 4) {
+		fprintf(stderr, "Usage: %s <output file> <data directory> <generated data directory>\n", argv[0]);
+		return 1;
+	}
+	if (!al_init()) {
+		fprintf(stderr, "Could not initialize Allegro\n");
+		return 1;
+	}
+
+	struct Files files = {0};
+	ALLEGRO_FS_ENTRY *root = al_create_fs_entry(argv[2]);
+	bool ok = AddFiles(root, "", false, &files);
+	al_destroy_fs_entry(root);
+	root = al_create_fs_entry(argv[3]);
+	ok &= AddFiles(root, "", true, &files);
+	al_destroy_fs_entry(root);
+	if (!ok) {
+		return 1;
+	}
+	qsort(files.files, files.count, sizeof(struct File), CompareLayout);
+
+	struct DataArchiveHeader header;
+	memcpy(header.magic, DATA_ARCHIVE_MAGIC, 4);
+	header.version = DATA_ARCHIVE_VERSION;
+	header.count = files.count;
+	header.reserved = 0;
+
+	struct DataArchiveEntry *entries = calloc(files.count, sizeof(struct DataArchiveEntry));
+	uint64_t offset = Align(sizeof(header) + files.count * sizeof(struct DataArchiveEntry));
+	int i;
+	for (i = 0; i < files.count; i++) {
+		memcpy(entries[i].path, files.files[i].path, DATA_ARCHIVE_PATH);
+		entries[i].offset = offset;
+		entries[i].size = files.files[i].size;
+		offset = Align(offset + files.files[i].size);
+	}
+	qsort(entries, files.count, sizeof(struct DataArchiveEntry), CompareEntries);
+
+	FILE *file = fopen(argv[1], "wb");
+	if (!file || (fwrite(&header, sizeof(header), 1, file) != 1) ||
+	    (fwrite(entries, sizeof(struct DataArchiveEntry), files.count, file) != (size_t)files.count)) {
+		fprintf(stderr, "Could not write %s\n", argv[1]);
+		return 1;
+	}
+	for (i = 0; i < files.count; i++) {
+		static const char padding[DATA_ARCHIVE_ALIGN];
+		size_t gap = Align(ftell(file)) - ftell(file);
+		if ((gap && (fwrite(padding, 1, gap, file) != gap)) || !CopyFile(file, files.files[i].filename, files.files[i].size)) {
+			fprintf(stderr, "Could not pack %s\n", files.files[i].filename);
+			fclose(file);
+			remove(argv[1]);
+			return 1;
+		}
+		free(files.files[i].filename);
+	}
+	fclose(file);
+
+	printf("Packed %d files, %llu bytes\n", files.count, (unsigned long long)offset);
+	free(entries);
+	free(files.files);
+	return 0;
+}
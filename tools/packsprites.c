@@ -0,0 +1,190 @@
+/*! \file packsprites.c
+ *  \brief Build-time tool packing all spritesheets into texture atlases.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+// Usage: packsprites <data/sprites directory> <output directory>
+//
+// Packs every spritesheet into as few atlas pages as possible, written to the
+// output directory as atlas-N.png, along with atlas.ini. That one
+// holds the number of pages and, for every spritesheet ("character/sheet"),
+// the page it ended up on and "x y w h" of its rectangle there. Sheets are
+// copied whole, so frames keep their layout and the ini files still apply.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#include "spritesheets.h"
+
+// Safe to upload everywhere we run.
+#define PAGE_SIZE 1024
+// Transparent gap between sheets, so filtering never samples a neighbour.
+#define PADDING 1
+
+struct Sheet {
+	char *name; // "character/sheet"
+	ALLEGRO_BITMAP *bitmap;
+	int w, h;
+	int page, x, y;
+};
+
+struct Sheets {
+	struct Sheet *sheets;
+	int count;
+};
+
+static bool AddSheet(const char *dir, const char *character, const char *sheet, void *data) {
+	struct Sheets *sheets = data;
+	char filename[1024];
+	snprintf(filename, 1024, "%s/%s/%s.png", dir, character, sheet);
+	ALLEGRO_BITMAP *bitmap = al_load_bitmap(filename);
+	if (!bitmap) {
+		fprintf(stderr, "Could not read %s\n", filename);
+		return false;
+	}
+	if ((al_get_bitmap_width(bitmap) + PADDING > PAGE_SIZE) || (al_get_bitmap_height(bitmap) + PADDING > PAGE_SIZE)) {
+		fprintf(stderr, "%s doesn't fit into a %dx%d atlas page\n", filename, PAGE_SIZE, PAGE_SIZE);
+		al_destroy_bitmap(bitmap);
+		return false;
+	}
+	sheets->sheets = realloc(sheets->sheets, sizeof(struct Sheet) * (sheets->count + 1));
+	struct Sheet *s = &sheets->sheets[sheets->count++];
+	snprintf(filename, 1024, "%s/%s", character, sheet);
+	s->name = strdup(filename);
+	s->bitmap = bitmap;
+	s->w = al_get_bitmap_width(bitmap);
+	s->h = al_get_bitmap_height(bitmap);
+	return true;
+}
+
+static int CompareSheets(const void *a, const void *b) {
+	// tallest first, so shelves waste as little height as possible
+	const struct Sheet *s1 = a, *s2 = b;
+	if (s1->h != s2->h) {
+		return s2->h - s1->h;
+	}
+	if (s1->w != s2->w) {
+		return s2->w - s1->w;
+	}
+	return strcmp(s1->name, s2->name);
+}
+
+static int Pack(struct Sheets *sheets, int *heights) {
+	// Simple shelf packing; returns the number of pages used and fills in
+	// how much of each page's height actually got used.
+	int page = 0, x = 0, y = 0, shelf = 0, i;
+	for (i = 0; i < sheets->count; i++) {
+		struct Sheet *s = &sheets->sheets[i];
+		if (x + s->w + PADDING > PAGE_SIZE) {
+			x = 0;
+			y += shelf;
+			shelf = 0;
+		}
+		if (y + s->h + PADDING > PAGE_SIZE) {
+			heights[page++] = y;
+			x = y = shelf = 0;
+		}
+		s->page = page;
+		s->x = x;
+		s->y = y;
+		x += s->w + PADDING;
+		if (s->h + PADDING > shelf) {
+			shelf = s->h + PADDING;
+		}
+	}
+	heights[page] = y + shelf;
+	return page + 1;
+}
+
+int main(int argc, char **argv) {
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <sprites directory> <output directory>\n", argv[0]);
+		return 1;
+	}
+	if (!al_init() || !al_init_image_addon()) {
+		fprintf(stderr, "Could not initialize Allegro\n");
+		return 1;
+	}
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+	al_set_new_bitmap_format(ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE);
+
+	struct Sheets sheets = {0};
+	if (!ForEachSpritesheet(argv[1], AddSheet, &sheets)) {
+		return 1;
+	}
+	qsort(sheets.sheets, sheets.count, sizeof(struct Sheet), CompareSheets);
+
+	int *heights = calloc(sheets.count + 1, sizeof(int));
+	int pages = Pack(&sheets, heights);
+
+	ALLEGRO_CONFIG *output = al_create_config();
+	char filename[1024], value[64];
+	int i, page;
+	long area = 0;
+	for (page = 0; page < pages; page++) {
+		// Only as tall as needed, rounded up to a power of two.
+		int h = 1;
+		while (h < heights[page]) {
+			h *= 2;
+		}
+		ALLEGRO_BITMAP *atlas = al_create_bitmap(PAGE_SIZE, h);
+		al_set_target_bitmap(atlas);
+		al_clear_to_color(al_map_rgba(0,0,0,0));
+		al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+		for (i = 0; i < sheets.count; i++) {
+			struct Sheet *s = &sheets.sheets[i];
+			if (s->page != page) {
+				continue;
+			}
+			al_draw_bitmap(s->bitmap, s->x, s->y, 0);
+			snprintf(value, 64, "%d", s->page);
+			al_set_config_value(output, s->name, "page", value);
+			snprintf(value, 64, "%d %d %d %d", s->x, s->y, s->w, s->h);
+			al_set_config_value(output, s->name, "rect", value);
+			area += s->w * s->h;
+		}
+		snprintf(filename, 1024, "%s/atlas-%d.png", argv[2], page);
+		if (!al_save_bitmap(filename, atlas)) {
+			fprintf(stderr, "Could not write %s\n", filename);
+			return 1;
+		}
+		al_destroy_bitmap(atlas);
+	}
+	snprintf(value, 64, "%d", pages);
+	al_set_config_value(output, "", "pages", value);
+
+	snprintf(filename, 1024, "%s/atlas.ini", argv[2]);
+	if (!al_save_config_file(filename, output)) {
+		fprintf(stderr, "Could not write %s\n", filename);
+		return 1;
+	}
+	al_destroy_config(output);
+
+	for (i = 0; i < sheets.count; i++) {
+		al_destroy_bitmap(sheets.sheets[i].bitmap);
+		free(sheets.sheets[i].name);
+	}
+	free(sheets.sheets);
+	free(heights);
+
+	printf("Packed %d spritesheets into %d atlas page(s), %ld%% used\n", sheets.count, pages, area * 100 / ((long)pages * PAGE_SIZE * PAGE_SIZE));
+	return 0;
+}
@@ -0,0 +1,141 @@
+/*! \file spritemanifest.c
+ *  \brief Build-time tool compiling all spritesheet ini files into one binary manifest.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+// Usage: spritemanifest <data/sprites directory> <output file>
+//
+// See src/spritemanifest.h for the format.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <allegro5/allegro.h>
+#include "spritesheets.h"
+#include "../src/spritemanifest.h"
+
+struct Records {
+	struct SpriteManifestRecord *records;
+	int count;
+};
+
+static const char *GetValue(ALLEGRO_CONFIG *config, const char *key) {
+	const char *value = al_get_config_value(config, "", key);
+	return value ? value : "0";
+}
+
+static bool IsEncoded(ALLEGRO_CONFIG *config, const char *filename) {
+	// Anything else the engine would read from the ini file can't be
+	// reproduced from a record, so such sheets are rejected outright.
+	static const char *keys[] = {"rows", "cols", "blanks", "delay"};
+	ALLEGRO_CONFIG_SECTION *section;
+	const char *name = al_get_first_config_section(config, &section);
+	for (; name; name = al_get_next_config_section(&section)) {
+		if (*name) {
+			fprintf(stderr, "%s has a [%s] section, which the manifest can't encode\n", filename, name);
+			return false;
+		}
+	}
+	ALLEGRO_CONFIG_ENTRY *entry;
+	const char *key = al_get_first_config_entry(config, "", &entry);
+	for (; key; key = al_get_next_config_entry(&entry)) {
+		size_t i;
+		for (i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+			if (!strcmp(key, keys[i])) {
+				break;
+			}
+		}
+		if (i == sizeof(keys) / sizeof(keys[0])) {
+			fprintf(stderr, "%s has a \"%s\" key, which the manifest can't encode\n", filename, key);
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool AddRecord(const char *dir, const char *character, const char *sheet, void *data) {
+	struct Records *records = data;
+	if ((strlen(character) >= SPRITE_MANIFEST_NAME) || (strlen(sheet) >= SPRITE_MANIFEST_NAME)) {
+		fprintf(stderr, "Name of %s/%s is too long\n", character, sheet);
+		return false;
+	}
+	char filename[1024];
+	snprintf(filename, 1024, "%s/%s/%s.ini", dir, character, sheet);
+	ALLEGRO_CONFIG *config = al_load_config_file(filename);
+	if (!config) {
+		fprintf(stderr, "Could not read %s\n", filename);
+		return false;
+	}
+	if (!IsEncoded(config, filename)) {
+		al_destroy_config(config);
+		return false;
+	}
+	records->records = realloc(records->records, sizeof(struct SpriteManifestRecord) * (records->count + 1));
+	struct SpriteManifestRecord *record = &records->records[records->count++];
+	memset(record, 0, sizeof(struct SpriteManifestRecord));
+	strcpy(record->character, character);
+	strcpy(record->spritesheet, sheet);
+	// parsed just like the engine does
+	record->rows = atoi(GetValue(config, "rows"));
+	record->cols = atoi(GetValue(config, "cols"));
+	record->blanks = atoi(GetValue(config, "blanks"));
+	record->delay = atof(GetValue(config, "delay"));
+	al_destroy_config(config);
+	return true;
+}
+
+static int CompareRecords(const void *a, const void *b) {
+	const struct SpriteManifestRecord *r1 = a, *r2 = b;
+	int result = strcmp(r1->character, r2->character);
+	return result ? result : strcmp(r1->spritesheet, r2->spritesheet);
+}
+
+int main(int argc, char **argv) {
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <sprites directory> <output file>\n", argv[0]);
+		return 1;
+	}
+	if (!al_init()) {
+		fprintf(stderr, "Could not initialize Allegro\n");
+		return 1;
+	}
+
+	struct Records records = {0};
+	if (!ForEachSpritesheet(argv[1], AddRecord, &records)) {
+		return 1;
+	}
+	qsort(records.records, records.count, sizeof(struct SpriteManifestRecord), CompareRecords);
+
+	struct SpriteManifestHeader header;
+	memcpy(header.magic, SPRITE_MANIFEST_MAGIC, 4);
+	header.version = SPRITE_MANIFEST_VERSION;
+	header.count = records.count;
+
+	FILE *file = fopen(argv[2], "wb");
+	if (!file || (fwrite(&header, sizeof(header), 1, file) != 1) ||
+	    (fwrite(records.records, sizeof(struct SpriteManifestRecord), records.count, file) != (size_t)records.count)) {
+		fprintf(stderr, "Could not write %s\n", argv[2]);
+		return 1;
+	}
+	fclose(file);
+	free(records.records);
+
+	printf("Compiled %d spritesheet descriptions\n", records.count);
+	return 0;
+}
@@ -0,0 +1,60 @@
+/*! \file spritesheets.c
+ *  \brief Walking the spritesheets of a data/sprites directory.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <allegro5/allegro.h>
+#include "spritesheets.h"
+
+bool ForEachSpritesheet(const char *dir, bool (*callback)(const char *dir, const char *character, const char *sheet, void *data), void *data) {
+	bool ok = true;
+
+	ALLEGRO_FS_ENTRY *root = al_create_fs_entry(dir);
+	if (!al_open_directory(root)) {
+		fprintf(stderr, "Could not open %s\n", dir);
+		al_destroy_fs_entry(root);
+		return false;
+	}
+	ALLEGRO_FS_ENTRY *chardir;
+	while ((chardir = al_read_directory(root))) {
+		if (!(al_get_fs_entry_mode(chardir) & ALLEGRO_FILEMODE_ISDIR) || !al_open_directory(chardir)) {
+			al_destroy_fs_entry(chardir);
+			continue;
+		}
+		ALLEGRO_PATH *charpath = al_create_path_for_directory(al_get_fs_entry_name(chardir));
+		const char *character = al_get_path_component(charpath, -1);
+		ALLEGRO_FS_ENTRY *file;
+		while ((file = al_read_directory(chardir))) {
+			ALLEGRO_PATH *path = al_create_path(al_get_fs_entry_name(file));
+			if (!strcmp(al_get_path_extension(path), ".ini")) {
+				ok &= callback(dir, character, al_get_path_basename(path), data);
+			}
+			al_destroy_path(path);
+			al_destroy_fs_entry(file);
+		}
+		al_destroy_path(charpath);
+		al_close_directory(chardir);
+		al_destroy_fs_entry(chardir);
+	}
+	al_close_directory(root);
+	al_destroy_fs_entry(root);
+	return ok;
+}
@@ -0,0 +1,26 @@
+/*! \file spritesheets.h
+ *  \brief Walking the spritesheets of a data/sprites directory.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <stdbool.h>
+
+// Calls the callback with every "character/sheet" pair that has an ini file
+// in the given directory. Returns false if anything failed.
+bool ForEachSpritesheet(const char *dir, bool (*callback)(const char *dir, const char *character, const char *sheet, void *data), void *data);
@@ -0,0 +1,128 @@
+/*! \file trimsprites.c
+ *  \brief Build-time tool computing the opaque bounds of every spritesheet frame.
+ */
+/*
+ * Copyright (c) Sebastian Krzyszkowiak <dos@dosowisko.net>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+// Usage: trimsprites <data/sprites directory> <output file>
+//
+// Writes an ini file with one section per spritesheet ("character/sheet"),
+// holding the number of frames and, for every frame, "x y w h" of the area
+// that actually has any opaque pixels, relative to the frame's top-left corner.
+// The game uses it to draw only that part, at the same position as before.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_image.h>
+#include "spritesheets.h"
+
+static long total_area, trimmed_area;
+
+static void TrimFrame(ALLEGRO_LOCKED_REGION *lock, int fx, int fy, int w, int h, int *rect) {
+	int minx = w, miny = h, maxx = -1, maxy = -1;
+	int x, y;
+	for (y = 0; y < h; y++) {
+		unsigned char *row = (unsigned char*)lock->data + (fy + y) * lock->pitch + fx * 4;
+		for (x = 0; x < w; x++) {
+			if (row[x * 4 + 3]) {
+				if (x < minx) minx = x;
+				if (x > maxx) maxx = x;
+				if (y < miny) miny = y;
+				if (y > maxy) maxy = y;
+			}
+		}
+	}
+	if (maxx < 0) {
+		// fully transparent frame
+		rect[0] = rect[1] = rect[2] = rect[3] = 0;
+		return;
+	}
+	rect[0] = minx;
+	rect[1] = miny;
+	rect[2] = maxx - minx + 1;
+	rect[3] = maxy - miny + 1;
+}
+
+static bool TrimSheet(const char *dir, const char *character, const char *sheet, void *data) {
+	ALLEGRO_CONFIG *output = data;
+	char filename[1024];
+	snprintf(filename, 1024, "%s/%s/%s.ini", dir, character, sheet);
+	ALLEGRO_CONFIG *config = al_load_config_file(filename);
+	if (!config) {
+		fprintf(stderr, "Could not read %s\n", filename);
+		return false;
+	}
+	int rows = atoi(al_get_config_value(config, "", "rows"));
+	int cols = atoi(al_get_config_value(config, "", "cols"));
+	int blanks = atoi(al_get_config_value(config, "", "blanks"));
+	al_destroy_config(config);
+
+	snprintf(filename, 1024, "%s/%s/%s.png", dir, character, sheet);
+	ALLEGRO_BITMAP *bitmap = al_load_bitmap(filename);
+	if (!bitmap) {
+		fprintf(stderr, "Could not read %s\n", filename);
+		return false;
+	}
+	int w = al_get_bitmap_width(bitmap) / cols, h = al_get_bitmap_height(bitmap) / rows;
+	ALLEGRO_LOCKED_REGION *lock = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+
+	char section[255], key[16], value[64];
+	snprintf(section, 255, "%s/%s", character, sheet);
+	int frames = rows * cols - blanks, i;
+	snprintf(value, 64, "%d", frames);
+	al_set_config_value(output, section, "frames", value);
+	for (i = 0; i < frames; i++) {
+		int rect[4];
+		TrimFrame(lock, (i % cols) * w, (i / cols) * h, w, h, rect);
+		snprintf(key, 16, "%d", i);
+		snprintf(value, 64, "%d %d %d %d", rect[0], rect[1], rect[2], rect[3]);
+		al_set_config_value(output, section, key, value);
+		total_area += w * h;
+		trimmed_area += rect[2] * rect[3];
+	}
+
+	al_unlock_bitmap(bitmap);
+	al_destroy_bitmap(bitmap);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <sprites directory> <output file>\n", argv[0]);
+		return 1;
+	}
+	if (!al_init() || !al_init_image_addon()) {
+		fprintf(stderr, "Could not initialize Allegro\n");
+		return 1;
+	}
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+	ALLEGRO_CONFIG *output = al_create_config();
+	bool ok = ForEachSpritesheet(argv[1], TrimSheet, output);
+
+	if (!ok || !al_save_config_file(argv[2], output)) {
+		fprintf(stderr, "Could not write %s\n", argv[2]);
+		return 1;
+	}
+	al_destroy_config(output);
+
+	printf("Trimmed sprite frames to %ld%% of their area\n", total_area ? trimmed_area * 100 / total_area : 100);
+	return 0;
+}